@@ -0,0 +1,445 @@
+/* createfs.c - builds a filesys_img from a directory tree on the host
+ *
+ * Usage: createfs -i <fsdir> -o <image> [-e <spare>] [-x] [-z]
+ *
+ * The image has the layout student-distrib/filesys.c reads: a 4KB boot block
+ * holding the root directory, then the inodes, then the datablocks.  Every
+ * subdirectory of fsdir becomes a directory dentry (type 1) whose inode's
+ * datablocks hold its dentries, 64 per block, so subdirectories have no
+ * entry limit.  The root directory keeps the boot block format and its
+ * 63 entries, and always starts with "." and "rtc" like the original tool.
+ *
+ * -e leaves that many free inodes and free datablocks in the image, for the
+ * kernel's writable mode to create and grow files in.
+ *
+ * -x writes extent inodes instead of block lists: each inode holds
+ * (start, count) runs of datablocks and the boot block's format field says
+ * so.  Files are laid out back to back, so every file is a single run.
+ *
+ * -z compresses each datablock on its own as an LZ4 block, so the kernel can
+ * still decompress any one block on demand.  The boot block and inodes stay
+ * as they are; the datablock area is replaced by a table of data_count + 1
+ * offsets (block i's bytes are from entry i to entry i + 1, counted from the
+ * end of the table) followed by the compressed blocks.  A block that doesn't
+ * get smaller is stored as its 4KB.  Compressed images are read-only.
+ *
+ * The structures below mirror filesys.h and are written as-is, so the
+ * builder has to run on a little-endian host.
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILENAME_LEN	32
+#define ABS_BLOCK_SIZE	4096
+#define NUM_FILES	63
+#define DATABLOCK_SIZE	1023
+#define MIN_INODES	64		/* the original images always have 64 inodes */
+#define MAX_DEPTH	8		/* same limit as DIR_MAX_DEPTH in filesys.h */
+#define PATH_MAX_LEN	1024
+#define FS_FORMAT_EXTENT	0x31545845	/* "EXT1", same as filesys.h */
+#define EXTENTS_PER_INODE	511
+#define FS_COMPRESS_LZ4		0x20345a4c	/* "LZ4 ", same as filesys.h */
+#define LZ4_MIN_MATCH	4
+#define LZ4_LAST_LITERALS	5	/* a block ends in at least this many literals */
+#define LZ4_MFLIMIT	12		/* and its last match starts at least this far from the end */
+#define LZ4_HASH_BITS	12
+#define LZ4_BOUND(len)	((len) + (len) / 255 + 16)	/* worst case compressed size */
+
+typedef struct dentry {
+    char file_name[FILENAME_LEN];
+    int32_t file_type;
+    int32_t inode_num;
+    int8_t reserved[24];
+} dentry_t;
+
+typedef struct inode {
+    int32_t length;
+    int32_t data_block[DATABLOCK_SIZE];
+} inode_t;
+
+typedef struct extent {
+    uint32_t start;
+    uint32_t count;
+} extent_t;
+
+typedef struct extent_inode {
+    int32_t length;
+    int32_t extent_count;
+    extent_t extents[EXTENTS_PER_INODE];
+} extent_inode_t;
+
+typedef struct boot_block {
+    int32_t dir_count;
+    int32_t inode_count;
+    int32_t data_count;
+    uint32_t format;
+    uint32_t compression;
+    int8_t reserved[44];
+    dentry_t dir_entries[NUM_FILES];
+} boot_block_t;
+
+/* contents of one inode, files and directories alike */
+typedef struct node {
+    uint8_t* data;
+    uint32_t length;
+} node_t;
+
+static node_t* nodes;
+static uint32_t node_count, node_cap;
+
+static uint32_t
+add_node (uint8_t* data, uint32_t length)
+{
+    if (node_count == node_cap) {
+        node_cap = node_cap ? node_cap * 2 : 64;
+        if (NULL == (nodes = realloc (nodes, node_cap * sizeof (*nodes)))) {
+	    perror ("realloc");
+	    exit (3);
+	}
+    }
+    nodes[node_count].data = data;
+    nodes[node_count].length = length;
+    return node_count++;
+}
+
+static uint8_t*
+read_whole_file (const char* path, uint32_t* length)
+{
+    FILE* f;
+    struct stat st;
+    uint8_t* data;
+
+    if (-1 == stat (path, &st)) {
+        perror (path);
+	return NULL;
+    }
+    if (st.st_size > (off_t)DATABLOCK_SIZE * ABS_BLOCK_SIZE) {
+        fprintf (stderr, "%s: too large for one inode\n", path);
+	return NULL;
+    }
+    *length = st.st_size;
+    if (NULL == (data = malloc (st.st_size ? st.st_size : 1)) ||
+        NULL == (f = fopen (path, "rb"))) {
+        perror (path);
+	return NULL;
+    }
+    if (*length != fread (data, 1, *length, f)) {
+        fprintf (stderr, "%s: short read\n", path);
+	fclose (f);
+	return NULL;
+    }
+    fclose (f);
+    return data;
+}
+
+static uint32_t
+read32 (const uint8_t* p)
+{
+    uint32_t v;
+    memcpy (&v, p, sizeof (v));
+    return v;
+}
+
+static uint8_t*
+lz4_put_length (uint8_t* op, uint32_t length)
+{
+    for (; length >= 255; length -= 255)
+        *op++ = 255;
+    *op++ = length;
+    return op;
+}
+
+/*
+ * Writes one LZ4 sequence: literals followed by a match, or just literals
+ * when match_len is 0 (the last sequence of a block).
+ */
+static uint8_t*
+lz4_put_sequence (uint8_t* op, const uint8_t* literals, uint32_t lit_len,
+		  uint32_t offset, uint32_t match_len)
+{
+    uint8_t* token = op++;
+
+    *token = (lit_len < 15 ? lit_len : 15) << 4;
+    if (lit_len >= 15)
+        op = lz4_put_length (op, lit_len - 15);
+    memcpy (op, literals, lit_len);
+    op += lit_len;
+    if (0 == match_len)
+        return op;
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+    match_len -= LZ4_MIN_MATCH;
+    *token |= match_len < 15 ? match_len : 15;
+    if (match_len >= 15)
+        op = lz4_put_length (op, match_len - 15);
+    return op;
+}
+
+/*
+ * Greedy LZ4 block compressor with a hash table of the last position each
+ * 4-byte sequence was seen at.  dst needs LZ4_BOUND(len) bytes.  Returns
+ * the compressed size.
+ */
+static uint32_t
+lz4_compress (const uint8_t* src, uint32_t len, uint8_t* dst)
+{
+    uint32_t table[1 << LZ4_HASH_BITS];	/* position + 1, 0 if not seen */
+    uint32_t ip = 0, anchor = 0, ref, match_len, h;
+    uint8_t* op = dst;
+
+    memset (table, 0, sizeof (table));
+    while (len >= LZ4_MFLIMIT && ip <= len - LZ4_MFLIMIT) {
+        h = (read32 (src + ip) * 2654435761U) >> (32 - LZ4_HASH_BITS);
+	ref = table[h];
+	table[h] = ip + 1;
+	if (0 == ref || ip - (ref - 1) > 0xFFFF ||
+	    read32 (src + ref - 1) != read32 (src + ip)) {
+	    ip++;
+	    continue;
+	}
+	ref--;
+	for (match_len = LZ4_MIN_MATCH;
+	     ip + match_len < len - LZ4_LAST_LITERALS && src[ref + match_len] == src[ip + match_len];
+	     match_len++);
+	op = lz4_put_sequence (op, src + anchor, ip - anchor, ip - ref, match_len);
+	ip += match_len;
+	anchor = ip;
+    }
+    op = lz4_put_sequence (op, src + anchor, len - anchor, 0, 0);
+    return op - dst;
+}
+
+/*
+ * Writes the boot block and inodes of image as they are, then the
+ * datablocks compressed one at a time behind their offset table.  Returns
+ * the number of bytes written, or 0 on error.
+ */
+static size_t
+write_compressed (FILE* f, uint8_t* image, uint32_t inode_count, uint32_t data_count)
+{
+    uint32_t* table;
+    uint8_t* packed;
+    uint8_t* blocks;
+    uint32_t i, size, used = 0;
+    size_t meta_len = (size_t)(1 + inode_count) * ABS_BLOCK_SIZE;
+
+    table = malloc ((data_count + 1) * sizeof (*table));
+    packed = malloc ((size_t)data_count * LZ4_BOUND (ABS_BLOCK_SIZE) + 1);
+    if (NULL == table || NULL == packed) {
+        perror ("malloc");
+	return 0;
+    }
+    blocks = image + meta_len;
+    for (i = 0; i < data_count; i++) {
+        table[i] = used;
+	size = lz4_compress (blocks + (size_t)i * ABS_BLOCK_SIZE, ABS_BLOCK_SIZE, packed + used);
+	if (size >= ABS_BLOCK_SIZE) {
+	    memcpy (packed + used, blocks + (size_t)i * ABS_BLOCK_SIZE, ABS_BLOCK_SIZE);
+	    size = ABS_BLOCK_SIZE;
+	}
+	used += size;
+    }
+    table[data_count] = used;
+
+    if (meta_len != fwrite (image, 1, meta_len, f) ||
+        data_count + 1 != fwrite (table, sizeof (*table), data_count + 1, f) ||
+	used != fwrite (packed, 1, used, f))
+        return 0;
+    free (table);
+    free (packed);
+    return meta_len + (data_count + 1) * sizeof (*table) + used;
+}
+
+static int
+name_cmp (const void* a, const void* b)
+{
+    return strcmp (*(char* const*)a, *(char* const*)b);
+}
+
+/*
+ * Reads the directory at path and fills *entries with one dentry per file
+ * or subdirectory, sorted by name.  Files and subdirectories get inodes as
+ * they are met.  Returns the number of entries, or -1 on error.
+ */
+static int32_t
+build_dir (const char* path, int depth, dentry_t** entries)
+{
+    DIR* dir;
+    struct dirent* de;
+    struct stat st;
+    char** names = NULL;
+    char child[PATH_MAX_LEN];
+    dentry_t* out;
+    dentry_t* sub;
+    uint8_t* data;
+    uint32_t length;
+    int32_t count = 0, cap = 0, sub_count, i, j;
+
+    if (depth > MAX_DEPTH) {
+        fprintf (stderr, "%s: nested too deep\n", path);
+	return -1;
+    }
+    if (NULL == (dir = opendir (path))) {
+        perror (path);
+	return -1;
+    }
+    while (NULL != (de = readdir (dir))) {
+        if (0 == strcmp (de->d_name, ".") || 0 == strcmp (de->d_name, ".."))
+	    continue;
+	if (count == cap) {
+	    cap = cap ? cap * 2 : 16;
+	    names = realloc (names, cap * sizeof (*names));
+	}
+	names[count++] = strdup (de->d_name);
+    }
+    closedir (dir);
+    qsort (names, count, sizeof (*names), name_cmp);
+
+    out = calloc (count ? count : 1, sizeof (*out));
+    for (i = 0; i < count; i++) {
+        snprintf (child, sizeof (child), "%s/%s", path, names[i]);
+	if (-1 == stat (child, &st)) {
+	    perror (child);
+	    return -1;
+	}
+	/* long names are cut to 32 characters, just like the original tool */
+	strncpy (out[i].file_name, names[i], FILENAME_LEN);
+	for (j = 0; j < i; j++) {
+	    if (0 == strncmp (out[j].file_name, out[i].file_name, FILENAME_LEN)) {
+	        fprintf (stderr, "%s: same first 32 characters as another name\n", child);
+		return -1;
+	    }
+	}
+	if (S_ISDIR (st.st_mode)) {
+	    if (-1 == (sub_count = build_dir (child, depth + 1, &sub)))
+	        return -1;
+	    out[i].file_type = 1;
+	    out[i].inode_num = add_node ((uint8_t*)sub, sub_count * sizeof (dentry_t));
+	} else {
+	    if (NULL == (data = read_whole_file (child, &length)))
+	        return -1;
+	    out[i].file_type = 2;
+	    out[i].inode_num = add_node (data, length);
+	}
+	free (names[i]);
+    }
+    free (names);
+    *entries = out;
+    return count;
+}
+
+int
+main (int argc, char* argv[])
+{
+    const char* in_dir = NULL;
+    const char* out_file = NULL;
+    uint32_t spare = 0, inode_count, data_count, block, i, j;
+    boot_block_t* boot;
+    inode_t* inode;
+    extent_inode_t* ext_inode;
+    dentry_t* root;
+    int32_t root_count;
+    uint8_t* image;
+    size_t image_len, written;
+    FILE* f;
+    int opt, extents = 0, compress = 0;
+
+    while (-1 != (opt = getopt (argc, argv, "i:o:e:xz"))) {
+        switch (opt) {
+	    case 'i': in_dir = optarg; break;
+	    case 'o': out_file = optarg; break;
+	    case 'e': spare = strtoul (optarg, NULL, 0); break;
+	    case 'x': extents = 1; break;
+	    case 'z': compress = 1; break;
+	    default: in_dir = NULL; break;
+	}
+    }
+    if (NULL == in_dir || NULL == out_file) {
+        fprintf (stderr, "usage: %s -i <fsdir> -o <image> [-e <spare>] [-x] [-z]\n", argv[0]);
+	return 2;
+    }
+    if (compress && 0 != spare) {
+        fprintf (stderr, "%s: compressed images are read-only, -e has no use\n", argv[0]);
+	return 2;
+    }
+
+    if (-1 == (root_count = build_dir (in_dir, 0, &root)))
+        return 3;
+    /* "." and "rtc" come first in the boot block */
+    if (root_count + 2 > NUM_FILES) {
+        fprintf (stderr, "%s: %d entries, the root directory holds %d\n",
+		 in_dir, root_count, NUM_FILES - 2);
+	return 3;
+    }
+
+    /* a compressed image can't grow, so it only needs the inodes it uses */
+    inode_count = node_count + spare > MIN_INODES || compress ? node_count + spare : MIN_INODES;
+    data_count = spare;
+    for (i = 0; i < node_count; i++)
+        data_count += (nodes[i].length + ABS_BLOCK_SIZE - 1) / ABS_BLOCK_SIZE;
+
+    image_len = (size_t)(1 + inode_count + data_count) * ABS_BLOCK_SIZE;
+    if (NULL == (image = calloc (1, image_len))) {
+        perror ("calloc");
+	return 3;
+    }
+
+    boot = (boot_block_t*)image;
+    boot->dir_count = root_count + 2;
+    boot->inode_count = inode_count;
+    boot->data_count = data_count;
+    boot->format = extents ? FS_FORMAT_EXTENT : 0;
+    boot->compression = compress ? FS_COMPRESS_LZ4 : 0;
+    strcpy (boot->dir_entries[0].file_name, ".");
+    boot->dir_entries[0].file_type = 1;
+    strcpy (boot->dir_entries[1].file_name, "rtc");
+    boot->dir_entries[1].file_type = 0;
+    memcpy (&boot->dir_entries[2], root, root_count * sizeof (dentry_t));
+
+    /* every inode's datablocks are laid out back to back */
+    block = 0;
+    for (i = 0; i < node_count; i++) {
+        inode = (inode_t*)(image + (1 + i) * ABS_BLOCK_SIZE);
+	inode->length = nodes[i].length;
+	if (extents && nodes[i].length > 0) {
+	    ext_inode = (extent_inode_t*)inode;
+	    ext_inode->extent_count = 1;
+	    ext_inode->extents[0].start = block;
+	    ext_inode->extents[0].count = (nodes[i].length + ABS_BLOCK_SIZE - 1) / ABS_BLOCK_SIZE;
+	}
+	for (j = 0; j * ABS_BLOCK_SIZE < nodes[i].length; j++, block++) {
+	    if (!extents)
+		inode->data_block[j] = block;
+	    memcpy (image + (1 + inode_count + block) * ABS_BLOCK_SIZE,
+		    nodes[i].data + j * ABS_BLOCK_SIZE,
+		    nodes[i].length - j * ABS_BLOCK_SIZE < ABS_BLOCK_SIZE ?
+		    nodes[i].length - j * ABS_BLOCK_SIZE : ABS_BLOCK_SIZE);
+	}
+    }
+
+    if (NULL == (f = fopen (out_file, "wb"))) {
+        perror (out_file);
+	return 3;
+    }
+    if (compress)
+        written = write_compressed (f, image, inode_count, data_count);
+    else
+        written = fwrite (image, 1, image_len, f);
+    if (0 == written || (!compress && image_len != written)) {
+        perror (out_file);
+	return 3;
+    }
+    fclose (f);
+    printf ("%s: %u inodes (%u used), %u datablocks (%u spare)%s%s\n", out_file,
+	    inode_count, node_count, data_count, spare, extents ? ", extent inodes" : "",
+	    compress ? ", compressed" : "");
+    if (compress)
+        printf ("%s: %zu bytes, %zu uncompressed\n", out_file, written, image_len);
+    return 0;
+}
@@ -0,0 +1,355 @@
+/* fsbench.c - kernel side of fsbench, drives student-distrib/filesys.c on the host
+ *
+ * Built against the kernel headers with fsbench_lib.h standing in for lib.h,
+ * and linked with filesys.o and lz4.o from the same sources the kernel uses.
+ * fsbench_run mounts the image with fs_init, walks every directory to
+ * collect the paths in it, checks lookups, directory listings and file
+ * reads, then times the same three paths:
+ *
+ *   lookup	read_dentry_by_name on every path, and on names that aren't there
+ *   read_dir	read_dir through a stand-in PCB, over every directory
+ *   read_data	whole files, and short reads at random offsets
+ *
+ * The random checks compare short reads against one whole-file read, so
+ * they catch run, extent and block cache boundary bugs even without the
+ * source directory to compare against.
+ */
+
+#include "filesys.h"
+#include "fsbench.h"
+
+#define BENCH_MAX_PATHS		1024
+#define BENCH_SHORT_READS	4096	/* (file, offset, length) triples the short read benchmark cycles through */
+#define BENCH_SHORT_LEN		512	/* longest short read */
+#define CHECK_SLACK		64	/* random checks start and end up to this far past EOF */
+
+typedef struct bench_path {
+    int8_t path[PATH_LEN];
+    dentry_t dentry;
+    uint32_t length;		/* file length, regular files only */
+} bench_path_t;
+
+typedef struct short_read {
+    uint32_t inode;
+    uint32_t offset;
+    uint32_t length;
+} short_read_t;
+
+static bench_path_t paths[BENCH_MAX_PATHS];
+static uint32_t path_count = 0;
+static int8_t missing[BENCH_MAX_PATHS][PATH_LEN + 2];
+static short_read_t short_reads[BENCH_SHORT_READS];
+
+/* read_data's buffers stay static, filesys.c may hold their addresses in uint32_t */
+static uint8_t whole[MAX_FILE_LEN + ABS_BLOCK_SIZE];
+static uint8_t ref[MAX_FILE_LEN + ABS_BLOCK_SIZE];
+static uint8_t part[MAX_FILE_LEN + ABS_BLOCK_SIZE];
+
+/* read_dir finds its directory and position in the current PCB's fd table */
+#define BENCH_DIR_FD	2
+static pcb_t bench_pcb;
+
+pcb_t*
+get_pcb_address ()
+{
+    return &bench_pcb;
+}
+
+/* nothing is mmapped on the host, truncate_data may free any datablock */
+int32_t
+mmap_page_mapped (uint32_t phys_addr)
+{
+    return 0;
+}
+
+/* nanoseconds per operation, 0 if nothing was timed */
+static uint32_t
+per_op (unsigned long long start, uint32_t ops)
+{
+    return 0 == ops ? 0 : (uint32_t)((host_time_ns () - start) / ops);
+}
+
+/*
+ * collect_paths
+ *   DESCRIPTION: appends every dentry in a directory to paths, then descends
+ *                into its subdirectories
+ *   INPUTS: dir -- directory inode, ROOT_DIR for the boot block
+ *           prefix -- path of the directory, "" for the root
+ *           depth -- nesting of dir below the root
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if paths overflowed or a dentry couldn't be read
+ */
+static int32_t
+collect_paths (uint32_t dir, const int8_t* prefix, uint32_t depth)
+{
+    dentry_t dentry;
+    bench_path_t* p;
+    uint32_t idx, len;
+
+    for (idx = 0; 0 == read_dentry_in_dir (dir, idx, &dentry); idx++) {
+        if (0 == strncmp (dentry.file_name, ".", FILENAME_LEN)
+	    || 0 == strncmp (dentry.file_name, "..", FILENAME_LEN))
+	    continue;
+	if (BENCH_MAX_PATHS == path_count)
+	    return -1;
+	p = &paths[path_count++];
+	len = strlen (prefix);
+	if (len + FILENAME_LEN + 2 > PATH_LEN)
+	    return -1;
+	strcpy (p->path, prefix);
+	if (0 != len)
+	    p->path[len++] = '/';
+	/* names filling all 32 bytes have no terminator */
+	strncpy (p->path + len, dentry.file_name, FILENAME_LEN);
+	p->path[len + FILENAME_LEN] = '\0';
+	memcpy (&p->dentry, &dentry, sizeof (dentry_t));
+	p->length = 2 == dentry.file_type ? get_inode_length (dentry.inode_num) : 0;
+	if (dentry_is_dir (&dentry) && depth + 1 < DIR_MAX_DEPTH
+	    && -1 == collect_paths (dentry.inode_num, p->path, depth + 1))
+	    return -1;
+    }
+    return 0;
+}
+
+/* a name that isn't in p's directory: p's last component with '~' added,
+ * or with its last character replaced by '~' if it already fills 32 chars */
+static void
+missing_path (const bench_path_t* p, int8_t* buf)
+{
+    uint32_t len = strlen (p->path), last = len;
+
+    while (last > 0 && '/' != p->path[last - 1])
+        last--;
+    strcpy (buf, p->path);
+    if (len - last < FILENAME_LEN) {
+        buf[len] = '~';
+	buf[len + 1] = '\0';
+    } else
+        buf[len - 1] = '~';
+}
+
+/* 1 if path is one of the collected paths */
+static int32_t
+is_collected (const int8_t* path)
+{
+    uint32_t i;
+
+    for (i = 0; i < path_count; i++)
+        if (0 == strncmp (paths[i].path, path, PATH_LEN))
+	    return 1;
+    return 0;
+}
+
+/*
+ * check_lookups
+ *   DESCRIPTION: every collected path resolves to the dentry it was listed
+ *                with, and every missing name fails
+ *   RETURN VALUE: number of failed checks
+ */
+static uint32_t
+check_lookups (void)
+{
+    dentry_t dentry;
+    uint32_t i, fails = 0;
+
+    for (i = 0; i < path_count; i++) {
+        if (-1 == read_dentry_by_name ((uint8_t*)paths[i].path, &dentry)
+	    || dentry.inode_num != paths[i].dentry.inode_num
+	    || dentry.file_type != paths[i].dentry.file_type) {
+	    printf ("lookup %s: wrong dentry\n", paths[i].path);
+	    fails++;
+	}
+	/* "name~" may be a file of its own */
+	if (0 == read_dentry_by_name ((uint8_t*)missing[i], &dentry) && !is_collected (missing[i])) {
+	    printf ("lookup %s: found, but isn't there\n", missing[i]);
+	    fails++;
+	}
+    }
+    return fails;
+}
+
+/* opens dir on BENCH_DIR_FD of the stand-in PCB, the way open() does */
+static void
+bench_open_dir (uint32_t dir)
+{
+    bench_pcb.file[BENCH_DIR_FD].inode = dir;
+    bench_pcb.file[BENCH_DIR_FD].pos = 0;
+    bench_pcb.file[BENCH_DIR_FD].flags = 1;
+}
+
+/*
+ * check_dir
+ *   DESCRIPTION: read_dir returns a directory's names in dentry order and
+ *                then 0
+ *   RETURN VALUE: number of failed checks
+ */
+static uint32_t
+check_dir (uint32_t dir)
+{
+    dentry_t dentry;
+    int8_t name[FILENAME_LEN + 1];
+    uint32_t idx;
+    int32_t len;
+
+    bench_open_dir (dir);
+    for (idx = 0; 0 == read_dentry_in_dir (dir, idx, &dentry); idx++) {
+        len = read_dir (BENCH_DIR_FD, name, FILENAME_LEN);
+	if (len <= 0 || 0 != strncmp (name, dentry.file_name, FILENAME_LEN)) {
+	    printf ("read_dir: entry %u wrong\n", idx);
+	    return 1;
+	}
+    }
+    if (0 != read_dir (BENCH_DIR_FD, name, FILENAME_LEN)) {
+        printf ("read_dir: no 0 after entry %u\n", idx);
+	return 1;
+    }
+    return 0;
+}
+
+/*
+ * check_file
+ *   DESCRIPTION: reads a file whole, compares it with the source directory
+ *                if there is one, then compares short reads at random
+ *                offsets with the whole read
+ *   INPUTS: p -- regular file to check
+ *           checks -- number of random reads
+ *           have_ref -- nonzero if host_read_ref has a source directory
+ *   RETURN VALUE: number of failed checks
+ */
+static uint32_t
+check_file (const bench_path_t* p, uint32_t checks, int have_ref)
+{
+    uint32_t inode = p->dentry.inode_num, n = p->length;
+    uint32_t i, offset, length, expect;
+    int32_t got;
+
+    got = read_data (inode, 0, whole, n + CHECK_SLACK);
+    if ((uint32_t)got != n) {
+        printf ("read_data %s: %d bytes of %u\n", p->path, got, n);
+	return 1;
+    }
+    if (have_ref && -1 != (got = host_read_ref ((const char*)p->path, ref, n + 1))
+	&& ((uint32_t)got != n || 0 != memcmp (whole, ref, n))) {
+        printf ("read_data %s: differs from the source file\n", p->path);
+	return 1;
+    }
+    for (i = 0; i < checks; i++) {
+        offset = host_rand () % (n + CHECK_SLACK);
+	/* mostly short reads, sometimes ones that cross several blocks */
+	length = host_rand () % (0 == (i & 7) ? 3 * ABS_BLOCK_SIZE : BENCH_SHORT_LEN);
+	expect = offset >= n ? 0 : (length > n - offset ? n - offset : length);
+	got = read_data (inode, offset, part, length);
+	if ((uint32_t)got != expect || 0 != memcmp (part, whole + offset, expect)) {
+	    printf ("read_data %s: %u bytes at %u wrong (got %d)\n", p->path, length, offset, got);
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/*
+ * fsbench_run
+ *   DESCRIPTION: mounts the image, runs the checks and prints the timings
+ *   INPUTS: mod_start, mod_end -- where the image is mapped
+ *           iterations -- passes each benchmark makes over its paths
+ *           checks -- random short reads checked, spread over the files
+ *           have_ref -- nonzero if file contents can be checked against -d
+ *   OUTPUTS: timings and failed checks on stdout
+ *   RETURN VALUE: 0 if every check passed, 1 otherwise
+ */
+int
+fsbench_run (unsigned int mod_start, unsigned int mod_end,
+	     unsigned int iterations, unsigned int checks, int have_ref)
+{
+    module_t mod;
+    int8_t name[FILENAME_LEN + 1];
+    dentry_t dentry;
+    unsigned long long start, bytes;
+    uint32_t i, j, dirs, files, entries, fails = 0;
+    bench_path_t* p;
+
+    mod.mod_start = mod_start;
+    mod.mod_end = mod_end;
+    fs_init (&mod);
+    printf ("%d inodes, %d datablocks%s%s\n", boot_block->inode_count, boot_block->data_count,
+	    boot_block->format == FS_FORMAT_EXTENT ? ", extent inodes" : "",
+	    boot_block->compression == FS_COMPRESS_LZ4 ? ", LZ4 datablocks" : "");
+
+    if (-1 == collect_paths (ROOT_DIR, "", 0)) {
+        printf ("more than %d paths, or a bad directory\n", BENCH_MAX_PATHS);
+	return 1;
+    }
+    for (i = 0, dirs = 1, files = 0; i < path_count; i++) {
+        dirs += dentry_is_dir (&paths[i].dentry);
+	files += 2 == paths[i].dentry.file_type;
+	missing_path (&paths[i], missing[i]);
+    }
+    printf ("%u paths, %u directories, %u files\n", path_count, dirs, files);
+
+    /* correctness first, the timings mean nothing if these fail */
+    fails += check_lookups ();
+    fails += check_dir (ROOT_DIR);
+    for (i = 0; i < path_count; i++) {
+        p = &paths[i];
+        if (dentry_is_dir (&p->dentry))
+	    fails += check_dir (p->dentry.inode_num);
+	else if (2 == p->dentry.file_type)
+	    fails += check_file (p, 0 == files ? 0 : checks / files + 1, have_ref);
+    }
+    printf ("checks: %u failed\n", fails);
+
+    start = host_time_ns ();
+    for (j = 0; j < iterations; j++)
+        for (i = 0; i < path_count; i++)
+	    read_dentry_by_name ((uint8_t*)paths[i].path, &dentry);
+    printf ("lookup hit:      %6u ns/op\n", per_op (start, iterations * path_count));
+
+    start = host_time_ns ();
+    for (j = 0; j < iterations; j++)
+        for (i = 0; i < path_count; i++)
+	    read_dentry_by_name ((uint8_t*)missing[i], &dentry);
+    printf ("lookup miss:     %6u ns/op\n", per_op (start, iterations * path_count));
+
+    start = host_time_ns ();
+    for (j = 0, entries = 0; j < iterations; j++) {
+        bench_open_dir (ROOT_DIR);
+	while (0 < read_dir (BENCH_DIR_FD, name, FILENAME_LEN))
+	    entries++;
+	for (i = 0; i < path_count; i++) {
+	    if (!dentry_is_dir (&paths[i].dentry))
+	        continue;
+	    bench_open_dir (paths[i].dentry.inode_num);
+	    while (0 < read_dir (BENCH_DIR_FD, name, FILENAME_LEN))
+	        entries++;
+	}
+    }
+    printf ("read_dir:        %6u ns/entry\n", per_op (start, entries));
+
+    start = host_time_ns ();
+    for (j = 0, bytes = 0; j < iterations; j++) {
+        for (i = 0; i < path_count; i++) {
+	    if (2 == paths[i].dentry.file_type)
+	        bytes += read_data (paths[i].dentry.inode_num, 0, whole, paths[i].length);
+	}
+    }
+    start = host_time_ns () - start;
+    printf ("read_data whole: %6u MB/s\n", 0 == start ? 0 : (uint32_t)(bytes * 1000 / start));
+
+    for (i = 0, j = 0; 0 != files && i < BENCH_SHORT_READS; j++) {
+        p = &paths[j % path_count];
+	if (2 != p->dentry.file_type || 0 == p->length)
+	    continue;
+	short_reads[i].inode = p->dentry.inode_num;
+	short_reads[i].offset = host_rand () % p->length;
+	short_reads[i].length = 1 + host_rand () % BENCH_SHORT_LEN;
+	i++;
+	j += host_rand () % path_count;
+    }
+    start = host_time_ns ();
+    for (j = 0; 0 != files && j < iterations; j++)
+        for (i = 0; i < BENCH_SHORT_READS; i++)
+	    read_data (short_reads[i].inode, short_reads[i].offset, part, short_reads[i].length);
+    printf ("read_data short: %6u ns/op\n", per_op (start, 0 == files ? 0 : iterations * BENCH_SHORT_READS));
+
+    return 0 == fails ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+/* fsbench.h - interface between the two halves of fsbench
+ *
+ * fsbench.c is built against the kernel headers and fsbench_host.c against
+ * libc, and the two can't share a header beyond this one: types.h and
+ * <stdint.h> disagree on int8_t, and filesys.h has its own struct stat.
+ * So only plain C types cross here.
+ */
+
+#ifndef _FSBENCH_H
+#define _FSBENCH_H
+
+/* fsbench_host.c */
+unsigned long long host_time_ns (void);
+unsigned int host_rand (void);
+int host_read_ref (const char* path, unsigned char* buf, unsigned int len);
+
+/* fsbench.c */
+int fsbench_run (unsigned int mod_start, unsigned int mod_end,
+		 unsigned int iterations, unsigned int checks, int have_ref);
+
+#endif /* _FSBENCH_H */
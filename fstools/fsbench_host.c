@@ -0,0 +1,111 @@
+/* fsbench_host.c - libc side of fsbench, the host benchmark of filesys.c
+ *
+ * Usage: fsbench [-i <image>] [-d <fsdir>] [-n <iterations>] [-c <checks>] [-s <seed>]
+ *
+ * Maps a filesystem image (../student-distrib/filesys_img by default) the
+ * way the bootloader would hand it to the kernel as a multiboot module, and
+ * lets fsbench.c run the kernel's filesys.c over it.  -d names the directory
+ * the image was built from, so file contents can be checked against the
+ * originals as well as against each other.
+ *
+ * filesys.c keeps addresses in uint32_t, so on a 64-bit host the image is
+ * mapped with MAP_32BIT and fsbench is linked -no-pie to keep its buffers
+ * below 4GB too.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fsbench.h"
+
+#ifndef MAP_32BIT
+#define MAP_32BIT	0	/* 32-bit hosts, every address fits */
+#endif
+
+#define PATH_MAX_LEN	1024
+
+static const char* ref_dir = NULL;
+
+unsigned long long
+host_time_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned int
+host_rand (void)
+{
+    return (unsigned int)rand ();
+}
+
+/* reads up to len bytes of <fsdir>/path, -1 if there's no such file */
+int
+host_read_ref (const char* path, unsigned char* buf, unsigned int len)
+{
+    char full[PATH_MAX_LEN];
+    FILE* f;
+    size_t got;
+
+    snprintf (full, sizeof (full), "%s/%s", ref_dir, path);
+    if (NULL == (f = fopen (full, "rb")))
+        return -1;
+    got = fread (buf, 1, len, f);
+    fclose (f);
+    return (int)got;
+}
+
+int
+main (int argc, char* argv[])
+{
+    const char* image = "../student-distrib/filesys_img";
+    unsigned int iterations = 1000, checks = 10000, seed = 391;
+    unsigned long addr;
+    struct stat st;
+    void* mod;
+    int fd, opt;
+
+    while (-1 != (opt = getopt (argc, argv, "i:d:n:c:s:"))) {
+        switch (opt) {
+	    case 'i': image = optarg; break;
+	    case 'd': ref_dir = optarg; break;
+	    case 'n': iterations = strtoul (optarg, NULL, 0); break;
+	    case 'c': checks = strtoul (optarg, NULL, 0); break;
+	    case 's': seed = strtoul (optarg, NULL, 0); break;
+	    default:
+	        fprintf (stderr, "usage: %s [-i <image>] [-d <fsdir>] [-n <iterations>] "
+			 "[-c <checks>] [-s <seed>]\n", argv[0]);
+		return 2;
+	}
+    }
+    srand (seed);
+
+    if (-1 == (fd = open (image, O_RDONLY)) || -1 == fstat (fd, &st)) {
+        perror (image);
+	return 3;
+    }
+    /* private, so writable mode's bitmaps and any writes stay in this process */
+    mod = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_32BIT, fd, 0);
+    close (fd);
+    if (MAP_FAILED == mod) {
+        perror ("mmap");
+	return 3;
+    }
+    addr = (unsigned long)mod;
+    if (addr + st.st_size > 0xFFFFFFFFUL) {
+        fprintf (stderr, "%s: image mapped above 4GB\n", image);
+	return 3;
+    }
+
+    printf ("%s: %lu bytes, seed %u\n", image, (unsigned long)st.st_size, seed);
+    return fsbench_run ((unsigned int)addr, (unsigned int)(addr + st.st_size),
+			iterations, checks, NULL != ref_dir);
+}
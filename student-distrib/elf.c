@@ -0,0 +1,119 @@
+/* elf.c - checks ELF executables and lays out their PT_LOAD segments in the user window */
+
+#include "elf.h"
+#include "lib.h"
+#include "filesys.h"
+#include "paging.h"
+
+/*
+ * int32_t elf_check(uint32_t inode, elf_image_t* image)
+ * Description: Reads the ELF header and program header table of a file and checks
+ *				that it is an i386 executable whose loadable segments all fit in the
+ *				4MB user page.
+ * Inputs: uint32_t inode - inode of the file to check
+ *		   elf_image_t* image - filled in with the headers
+ * Outputs: None
+ * Return Value: 0 if the file can be loaded, -1 otherwise
+ * Side Effects: None
+ */
+int32_t elf_check(uint32_t inode, elf_image_t* image)
+{
+	int8_t exe_identifier[4] = {0x7f, 0x45, 0x4c, 0x46};
+	elf_header_t* header = &image->header;
+	elf_phdr_t* phdr;
+	int32_t file_len, phdr_len;
+	uint8_t entry_found = 0;
+	int i;	// loop index
+
+	image->inode = inode;
+	file_len = get_inode_length(inode);
+
+	/* file header: magic number, 32-bit i386 executable */
+	if(read_data(inode, 0, (uint8_t*)header, sizeof(elf_header_t)) != sizeof(elf_header_t))
+		return -1;
+	if(strncmp((int8_t*)header->e_ident, exe_identifier, 4) != 0)
+		return -1;
+	if(header->e_ident[ELF_CLASS_IDX] != ELF_CLASS_32 || header->e_type != ELF_TYPE_EXEC
+		|| header->e_machine != ELF_MACHINE_386)
+		return -1;
+	if(header->e_phentsize != sizeof(elf_phdr_t) || header->e_phnum == 0 || header->e_phnum > ELF_MAX_PHDRS)
+		return -1;
+
+	/* program header table */
+	phdr_len = header->e_phnum * sizeof(elf_phdr_t);
+	if(read_data(inode, header->e_phoff, (uint8_t*)image->phdr, phdr_len) != phdr_len)
+		return -1;
+
+	for(i = 0; i < header->e_phnum; i++) {
+		phdr = &image->phdr[i];
+		if(phdr->p_type != ELF_PT_LOAD)
+			continue;
+		/* segment data has to be in the file, and the segment has to fit in the user page */
+		if(phdr->p_filesz > phdr->p_memsz || phdr->p_offset > file_len
+			|| phdr->p_filesz > file_len - phdr->p_offset)
+			return -1;
+		if(phdr->p_vaddr < USER_PAGE_START || phdr->p_vaddr >= USER_PAGE_END
+			|| phdr->p_memsz > USER_PAGE_END - phdr->p_vaddr)
+			return -1;
+		/* differences, not sums, so nothing can wrap around */
+		if(header->e_entry >= phdr->p_vaddr && header->e_entry - phdr->p_vaddr < phdr->p_filesz)
+			entry_found = 1;
+	}
+
+	/* the entry point has to land in loaded code */
+	if(!entry_found)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * void elf_regions(elf_image_t* image, pcb_t* pcb)
+ * Description: Sets up the regions of a new process for an executable checked by
+ *				elf_check: one per PT_LOAD segment, read from the file on first touch
+ *				(read-only segments as text other processes can share),
+ *				an empty heap after the highest segment and the stack below USER_PAGE_END.
+ *				Nothing is mapped or read here, the page fault handler does that.
+ * Inputs: elf_image_t* image - headers filled in by elf_check
+ *		   pcb_t* pcb - the new process
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void elf_regions(elf_image_t* image, pcb_t* pcb)
+{
+	elf_phdr_t* phdr;
+	region_t* region;
+	uint32_t heap = USER_PAGE_START;
+	int i;	// loop index
+
+	pcb->region_count = 0;
+	for(i = 0; i < image->header.e_phnum; i++) {
+		phdr = &image->phdr[i];
+		if(phdr->p_type != ELF_PT_LOAD || phdr->p_memsz == 0)
+			continue;
+		region = &pcb->regions[pcb->region_count++];
+		region->start = phdr->p_vaddr & ~(ENTRY_SIZE - 1);
+		region->end = (phdr->p_vaddr + phdr->p_memsz + ENTRY_SIZE - 1) & ~(ENTRY_SIZE - 1);
+		region->type = (phdr->p_flags & ELF_PF_W) ? REGION_FILE : REGION_TEXT;
+		region->inode = image->inode;
+		region->vaddr = phdr->p_vaddr;
+		region->offset = phdr->p_offset;
+		region->file_end = phdr->p_vaddr + phdr->p_filesz;
+		if(region->end > heap)
+			heap = region->end;
+	}
+
+	region = &pcb->regions[pcb->region_count++];
+	memset(region, 0, sizeof(region_t));
+	region->start = heap;
+	region->end = heap;
+	region->type = REGION_HEAP;
+	pcb->brk = heap;
+
+	region = &pcb->regions[pcb->region_count++];
+	memset(region, 0, sizeof(region_t));
+	region->start = USER_PAGE_END - USER_STACK_MAX > heap ? USER_PAGE_END - USER_STACK_MAX : heap;
+	region->end = USER_PAGE_END;
+	region->type = REGION_STACK;
+}
@@ -0,0 +1,65 @@
+/* elf.h - Defines used to load ELF executables into a process page */
+
+#ifndef _ELF_H
+#define _ELF_H
+
+#include "types.h"
+#include "syscall.h"
+
+#define ELF_IDENT_LEN		16
+#define ELF_CLASS_IDX		4		// e_ident[EI_CLASS]
+#define ELF_CLASS_32		1
+#define ELF_TYPE_EXEC		2		// ET_EXEC
+#define ELF_MACHINE_386		3		// EM_386
+#define ELF_PT_LOAD			1		// loadable segment
+#define ELF_PF_W			2		// p_flags: segment is writable
+#define ELF_MAX_PHDRS		8		// program headers we are willing to look at
+#define USER_PAGE_START		VIRTUAL_MEM_ADDR
+#define USER_PAGE_END		(VIRTUAL_MEM_ADDR + _4MB)
+#define USER_STACK_MAX		0x100000	// the user stack can grow this far below USER_PAGE_END
+#ifndef ASM
+
+/* ELF file header, the first 52 bytes of the executable */
+typedef struct elf_header {
+	uint8_t e_ident[ELF_IDENT_LEN];	/* magic number, class, data encoding */
+	uint16_t e_type;				/* object file type (2 = executable) */
+	uint16_t e_machine;				/* architecture (3 = i386) */
+	uint32_t e_version;
+	uint32_t e_entry;				/* virtual address of the first instruction */
+	uint32_t e_phoff;				/* file offset of the program header table */
+	uint32_t e_shoff;
+	uint32_t e_flags;
+	uint16_t e_ehsize;
+	uint16_t e_phentsize;			/* size of one program header */
+	uint16_t e_phnum;				/* number of program headers */
+	uint16_t e_shentsize;
+	uint16_t e_shnum;
+	uint16_t e_shstrndx;
+} elf_header_t;
+
+/* ELF program header, one per segment */
+typedef struct elf_phdr {
+	uint32_t p_type;				/* segment type (1 = PT_LOAD) */
+	uint32_t p_offset;				/* file offset of the segment data */
+	uint32_t p_vaddr;				/* virtual address to load the segment to */
+	uint32_t p_paddr;
+	uint32_t p_filesz;				/* bytes of the segment stored in the file */
+	uint32_t p_memsz;				/* bytes of the segment in memory, the rest is .bss */
+	uint32_t p_flags;
+	uint32_t p_align;
+} elf_phdr_t;
+
+/* header and program header table of an executable that passed elf_check */
+typedef struct elf_image {
+	uint32_t inode;
+	elf_header_t header;
+	elf_phdr_t phdr[ELF_MAX_PHDRS];
+} elf_image_t;
+
+/* reads and validates the headers of an executable */
+int32_t elf_check(uint32_t inode, elf_image_t* image);
+/* sets up the regions a checked executable's pages are faulted in from */
+void elf_regions(elf_image_t* image, pcb_t* pcb);
+
+#endif /* ASM */
+#endif /* _ELF_H */
@@ -1,4 +1,77 @@
 #include "filesys.h"
+#include "lz4.h"
+
+/* name -> dentry index table, open addressing with linear probing */
+int8_t dentry_hash[DENTRY_HASH_SIZE];
+
+/* (parent directory, name) -> dentry cache for directories stored in datablocks, direct mapped */
+dcache_entry_t dcache[DCACHE_SIZE];
+
+/* free maps for writable mode, a set bit means the inode/datablock is in use */
+uint32_t inode_bitmap[FS_MAX_INODES / 32];
+uint32_t data_bitmap[FS_MAX_DATA_BLOCKS / 32];
+uint8_t fs_writable = 0;			// set once fs_bitmap_init has built the free maps
+uint32_t inode_generation[FS_MAX_INODES];	// bumped whenever an inode's contents change or it is reused
+uint16_t inode_exec_users[FS_MAX_INODES];	// regions of running processes faulted in from the inode
+
+/* contiguous runs of block list inodes, collapsed at mount so reads copy a run at a time */
+extent_t run_pool[FS_RUN_POOL];
+run_index_t run_index[FS_MAX_INODES];
+uint32_t run_pool_used = 0;
+uint8_t fs_extent_format = 0;		// set when the image's inodes hold extents instead of block lists
+
+/* compressed images: a table of where each datablock's LZ4 block starts, then the blocks */
+uint8_t fs_compressed = 0;			// set when the datablocks are compressed, the image is then read-only
+uint32_t* block_table;				// data_count + 1 offsets from compressed_start, block i ends where i + 1 starts
+uint32_t compressed_start;
+uint32_t compressed_end;			// end of the module, no compressed block may run past it
+
+/* LRU cache of decompressed datablocks for reads that only want part of a block */
+block_cache_t block_cache[BLOCK_CACHE_SLOTS];
+uint8_t block_cache_data[BLOCK_CACHE_SLOTS][ABS_BLOCK_SIZE] __attribute__((aligned(ABS_BLOCK_SIZE)));
+uint32_t block_cache_clock = 0;
+
+/* number of datablocks a file of the given length occupies */
+#define FILE_BLOCKS(length) (((length) + ABS_BLOCK_SIZE - 1) / ABS_BLOCK_SIZE)
+
+static inline uint32_t bitmap_test(uint32_t* bitmap, uint32_t bit)
+{
+	return bitmap[bit >> 5] & (1 << (bit & 31));
+}
+
+static inline void bitmap_set(uint32_t* bitmap, uint32_t bit)
+{
+	bitmap[bit >> 5] |= (1 << (bit & 31));
+}
+
+static inline void bitmap_clear(uint32_t* bitmap, uint32_t bit)
+{
+	bitmap[bit >> 5] &= ~(1 << (bit & 31));
+}
+
+static inline inode_t* get_inode(uint32_t inode)
+{
+	return (inode_t*)(boot_block_end + (inode * ABS_BLOCK_SIZE));
+}
+
+/*
+ * uint32_t dentry_hash_name(const uint8_t* fname)
+ * Inputs: const uint8_t* fname - file name, at most FILENAME_LEN chars are used
+ * Outputs: None
+ * Return Value: FNV-1a hash of the name
+ * Side Effects: None
+ */
+static uint32_t dentry_hash_name(const uint8_t* fname)
+{
+	uint32_t hash = 2166136261U;	// FNV offset basis
+	int i;
+	/* names filling all 32 bytes are stored without a null terminator */
+	for(i = 0; i < FILENAME_LEN && fname[i] != '\0'; i++){
+		hash ^= fname[i];
+		hash *= 16777619U;			// FNV prime
+	}
+	return hash;
+}
 
 /*
  * void fs_init(module_t* file_sys_boot)
@@ -8,6 +81,7 @@
  * Side Effects: Reads in the 
  */
 void fs_init(module_t* file_sys_boot){
+	int i;
 	boot_block = (boot_block_t*)file_sys_boot->mod_start;		// initalizes boot_block_t ptr to be pointing to start of filesys bootimg
 	//boot_block_start = (uint32_t)file_sys_boot;
 	//boot_block_ptr = (boot_block_t*)((uint32_t)(file_sys_boot->mod_start));
@@ -18,12 +92,549 @@ void fs_init(module_t* file_sys_boot){
 	/* Length until start of data blocks */
 	//data_block_length = (boot_block_end +  len_inodes);
 	data_block_start = (unsigned int)boot_block + (boot_block->inode_count+1)*ABS_BLOCK_SIZE;
+	/* Extent images already store runs, block list images get them collapsed once here */
+	fs_extent_format = (boot_block->format == FS_FORMAT_EXTENT);
+	fs_run_index_init();
+	/* Compressed datablocks are found through the block table that takes their place */
+	fs_compressed = (boot_block->compression == FS_COMPRESS_LZ4);
+	if(fs_compressed){
+		block_table = (uint32_t*)data_block_start;
+		compressed_start = (uint32_t)(block_table + boot_block->data_count + 1);
+		compressed_end = file_sys_boot->mod_end;
+		for(i = 0; i < BLOCK_CACHE_SLOTS; i++)
+			block_cache[i].data_block = -1;
+	}
+	/* Index the directory once so name lookups don't scan it */
+	dentry_hash_init();
+	memset(dcache, 0, sizeof(dcache));
+#ifdef FS_WRITABLE
+	/* Build the free inode/datablock maps used by write_file, compressed datablocks can't be written */
+	fs_writable = (!fs_compressed && fs_bitmap_init() == 0);
+#endif
+}
+
+/*
+ * int32_t index_inode_runs(uint32_t inode)
+ * Inputs: uint32_t inode - inode number
+ * Outputs: None
+ * Return Value: 0 (indexed or nothing to index), -1 if the pool is full
+ * Side Effects: Collapses the inode's block list into runs at the end of the pool.
+ *				 A file that shrinks to as many runs or fewer keeps its old slots.
+ */
+static int32_t index_inode_runs(uint32_t inode)
+{
+	uint32_t block, first = run_pool_used, count = 0;
+	int32_t data_block;
+	inode_t* curr_inode;
+	extent_t* run = NULL;
+
+	if(fs_extent_format || inode >= FS_MAX_INODES || inode >= boot_block->inode_count)
+		return 0;
+	/* unindexed inodes (bad block lists, garbage lengths) are read a block at a time */
+	curr_inode = get_inode(inode);
+	if((uint32_t)curr_inode->length > MAX_FILE_LEN)
+		goto unindexed;
+	for(block = 0; block < FILE_BLOCKS(curr_inode->length); block++){
+		data_block = curr_inode->data_block[block];
+		if((uint32_t)data_block >= (uint32_t)boot_block->data_count)
+			goto unindexed;
+		if(run != NULL && run->start + run->count == data_block){
+			run->count++;
+			continue;
+		}
+		if(first + count >= FS_RUN_POOL){
+			run_index[inode].count = 0;
+			return -1;
+		}
+		run = &run_pool[first + count++];
+		run->start = data_block;
+		run->count = 1;
+	}
+	if(run_index[inode].count != 0 && count <= run_index[inode].count){
+		memmove(&run_pool[run_index[inode].first], &run_pool[first], count * sizeof(extent_t));
+		first = run_index[inode].first;
+	} else {
+		run_pool_used = first + count;
+	}
+	run_index[inode].first = first;
+	run_index[inode].count = count;
+	return 0;
+
+unindexed:
+	run_index[inode].count = 0;
+	return 0;
+}
+
+/*
+ * void fs_run_index_init()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Rebuilds the run index of every block list inode from scratch
+ */
+void fs_run_index_init()
+{
+	uint32_t inode;
+
+	run_pool_used = 0;
+	memset(run_index, 0, sizeof(run_index));
+	for(inode = 0; inode < boot_block->inode_count && inode < FS_MAX_INODES; inode++)
+		index_inode_runs(inode);
+}
+
+/*
+ * void reindex_inode_runs(uint32_t inode)
+ * Inputs: uint32_t inode - inode whose block list changed
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Reindexes the inode, repacking the whole pool if its tail is used up
+ */
+static void reindex_inode_runs(uint32_t inode)
+{
+	if(index_inode_runs(inode) == -1)
+		fs_run_index_init();
+}
+
+/*
+ * int32_t inode_run(uint32_t inode, uint32_t block, uint32_t* run_len)
+ * Inputs: uint32_t inode - inode number, checked by the caller
+ * 		   uint32_t block - index of the datablock within the file
+ * 		   uint32_t* run_len - filled in with how many datablocks from block on are contiguous
+ * Outputs: None
+ * Return Value: datablock number of the block, -1 if it is past the runs or out of the image
+ * Side Effects: None
+ */
+static int32_t inode_run(uint32_t inode, uint32_t block, uint32_t* run_len)
+{
+	inode_t* curr_inode = get_inode(inode);
+	extent_t* run;
+	uint32_t count, i;
+
+	if(fs_extent_format){
+		run = ((extent_inode_t*)curr_inode)->extents;
+		count = ((extent_inode_t*)curr_inode)->extent_count;
+		if(count > EXTENTS_PER_INODE)
+			return -1;
+	} else if(inode < FS_MAX_INODES && run_index[inode].count != 0){
+		run = &run_pool[run_index[inode].first];
+		count = run_index[inode].count;
+	} else {
+		if(block >= DATABLOCK_SIZE || (uint32_t)curr_inode->data_block[block] >= (uint32_t)boot_block->data_count)
+			return -1;
+		*run_len = 1;
+		return curr_inode->data_block[block];
+	}
+	for(i = 0; i < count; i++, run++){
+		if(block < run->count){
+			/* extents come straight from the image, so they are checked here */
+			if(run->start >= boot_block->data_count || run->count > boot_block->data_count - run->start)
+				return -1;
+			*run_len = run->count - block;
+			return run->start + block;
+		}
+		block -= run->count;
+	}
+	return -1;
+}
+
+/*
+ * int32_t inode_append_block(uint32_t inode, uint32_t block, uint32_t data_block)
+ * Inputs: uint32_t inode - inode number
+ * 		   uint32_t block - index the new datablock gets in the file, one past the last
+ * 		   uint32_t data_block - the new datablock
+ * Outputs: None
+ * Return Value: 0 (success), -1 if an extent inode has no extent left
+ * Side Effects: Block list inodes need reindex_inode_runs once the caller is done
+ */
+static int32_t inode_append_block(uint32_t inode, uint32_t block, uint32_t data_block)
+{
+	extent_inode_t* curr_inode;
+	extent_t* last;
+
+	if(!fs_extent_format){
+		get_inode(inode)->data_block[block] = data_block;
+		return 0;
+	}
+	curr_inode = (extent_inode_t*)get_inode(inode);
+	if(block == 0)
+		curr_inode->extent_count = 0;
+	/* a datablock right after the last run just grows it */
+	if(curr_inode->extent_count > 0){
+		last = &curr_inode->extents[curr_inode->extent_count - 1];
+		if(last->start + last->count == data_block){
+			last->count++;
+			return 0;
+		}
+	}
+	if(curr_inode->extent_count >= EXTENTS_PER_INODE)
+		return -1;
+	last = &curr_inode->extents[curr_inode->extent_count++];
+	last->start = data_block;
+	last->count = 1;
+	return 0;
+}
+
+/*
+ * void inode_trim_blocks(uint32_t inode, uint32_t blocks)
+ * Inputs: uint32_t inode - inode number
+ * 		   uint32_t blocks - number of datablocks the file keeps
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Drops the extents past the kept datablocks, block lists only need the
+ *				 length changed and the runs reindexed
+ */
+static void inode_trim_blocks(uint32_t inode, uint32_t blocks)
+{
+	extent_inode_t* curr_inode;
+	int32_t i;
+
+	if(!fs_extent_format){
+		reindex_inode_runs(inode);
+		return;
+	}
+	curr_inode = (extent_inode_t*)get_inode(inode);
+	for(i = 0; i < curr_inode->extent_count && blocks > 0; i++){
+		if(curr_inode->extents[i].count >= blocks)
+			curr_inode->extents[i].count = blocks;
+		blocks -= curr_inode->extents[i].count;
+	}
+	curr_inode->extent_count = i;
+}
+
+/*
+ * int32_t decompress_block(uint32_t data_block, uint8_t* buf)
+ * Inputs: uint32_t data_block - datablock number in a compressed image
+ * 		   uint8_t* buf - ABS_BLOCK_SIZE bytes to decompress into
+ * Outputs: None
+ * Return Value: 0 (success), -1 if the block table or the compressed block is bad
+ * Side Effects: None
+ */
+static int32_t decompress_block(uint32_t data_block, uint8_t* buf)
+{
+	uint32_t start, size;
+
+	if(data_block >= boot_block->data_count)
+		return -1;
+	start = block_table[data_block];
+	size = block_table[data_block + 1] - start;
+	if(block_table[data_block + 1] < start || size > ABS_BLOCK_SIZE || start > compressed_end - compressed_start
+		|| size > compressed_end - compressed_start - start)
+		return -1;
+	/* blocks that don't compress are stored as they are */
+	if(size == ABS_BLOCK_SIZE){
+		memcpy(buf, (uint8_t*)(compressed_start + start), ABS_BLOCK_SIZE);
+		return 0;
+	}
+	if(lz4_decompress((uint8_t*)(compressed_start + start), size, buf, ABS_BLOCK_SIZE) != ABS_BLOCK_SIZE)
+		return -1;
+	return 0;
+}
+
+/*
+ * uint8_t* block_cache_get(uint32_t data_block)
+ * Inputs: uint32_t data_block - datablock number in a compressed image
+ * Outputs: None
+ * Return Value: the decompressed datablock, NULL if it couldn't be decompressed
+ * Side Effects: A miss decompresses into the least recently used slot. The block stays
+ *				 valid until the next miss, so callers hold interrupts off while using it.
+ */
+static uint8_t* block_cache_get(uint32_t data_block)
+{
+	uint32_t slot, victim = 0;
+
+	block_cache_clock++;
+	for(slot = 0; slot < BLOCK_CACHE_SLOTS; slot++){
+		if(block_cache[slot].data_block == data_block){
+			block_cache[slot].last_used = block_cache_clock;
+			return block_cache_data[slot];
+		}
+		/* empty slots are taken first, they were never used */
+		if(block_cache[victim].data_block != -1
+			&& (block_cache[slot].data_block == -1 || block_cache[slot].last_used < block_cache[victim].last_used))
+			victim = slot;
+	}
+	if(decompress_block(data_block, block_cache_data[victim]) == -1){
+		block_cache[victim].data_block = -1;
+		return NULL;
+	}
+	block_cache[victim].data_block = data_block;
+	block_cache[victim].last_used = block_cache_clock;
+	return block_cache_data[victim];
+}
+
+/*
+ * int32_t copy_data_blocks(uint32_t data_block, uint32_t byte_offset, uint8_t* buf, uint32_t length)
+ * Inputs: uint32_t data_block - first datablock to copy from
+ * 		   uint32_t byte_offset - where in that datablock to start
+ * 		   uint8_t* buf - buffer to copy to
+ * 		   uint32_t length - bytes to copy, within a run of contiguous datablocks, and
+ *				within the one datablock for compressed images
+ * Outputs: None
+ * Return Value: 0 (success), -1 if a compressed block is bad
+ * Side Effects: None
+ */
+static int32_t copy_data_blocks(uint32_t data_block, uint32_t byte_offset, uint8_t* buf, uint32_t length)
+{
+	uint8_t* block;
+	uint32_t flags;
+
+	if(!fs_compressed){
+		memcpy(buf, (uint8_t*)(data_block_start + (data_block * ABS_BLOCK_SIZE) + byte_offset), length);
+		return 0;
+	}
+	/* whole blocks skip the cache, so streaming through a big file doesn't push out hot blocks */
+	if(byte_offset == 0 && length == ABS_BLOCK_SIZE)
+		return decompress_block(data_block, buf);
+	/* fault the buffer in first, a page fault while copying could read a program page
+	   through the cache and evict the block being copied from */
+	*(volatile uint8_t*)buf = 0;
+	*(volatile uint8_t*)(buf + length - 1) = 0;
+	cli_and_save(flags);
+	block = block_cache_get(data_block);
+	if(block != NULL)
+		memcpy(buf, block + byte_offset, length);
+	restore_flags(flags);
+	return block == NULL ? -1 : 0;
+}
+
+/*
+ * int32_t mark_file_blocks(uint32_t inode)
+ * Inputs: uint32_t inode - inode of a regular file or directory
+ * Outputs: None
+ * Return Value: 0 (success), -1 if the inode is bad or already in use
+ * Side Effects: Marks the inode and every datablock inside its length as in use
+ */
+static int32_t mark_file_blocks(uint32_t inode)
+{
+	uint32_t block, run_len = 0;
+	int32_t data_block = 0;
+	inode_t* curr_inode;
+
+	/* an inode reachable twice would be freed twice, and a directory could contain itself */
+	if(inode >= boot_block->inode_count || bitmap_test(inode_bitmap, inode))
+		return -1;
+	bitmap_set(inode_bitmap, inode);
+	curr_inode = get_inode(inode);
+	if((uint32_t)curr_inode->length > MAX_FILE_LEN)
+		return -1;
+	for(block = 0; block < FILE_BLOCKS(curr_inode->length); block++, run_len--, data_block++){
+		if(run_len == 0 && (data_block = inode_run(inode, block, &run_len)) == -1)
+			return -1;
+		bitmap_set(data_bitmap, data_block);
+	}
+	return 0;
+}
+
+/*
+ * int32_t mark_dir_blocks(uint32_t dir, uint32_t depth)
+ * Inputs: uint32_t dir - directory inode, ROOT_DIR for the boot block directory
+ * 		   uint32_t depth - how many directories deep dir is
+ * Outputs: None
+ * Return Value: 0 (success), -1 if the tree is too deep or points at bad inodes/blocks
+ * Side Effects: Marks everything reachable from the directory as in use
+ */
+static int32_t mark_dir_blocks(uint32_t dir, uint32_t depth)
+{
+	uint32_t dir_entry_idx;
+	dentry_t current;
+
+	if(depth > DIR_MAX_DEPTH)
+		return -1;
+	for(dir_entry_idx = 0; read_dentry_in_dir(dir, dir_entry_idx, &current) == 0; dir_entry_idx++){
+		if(current.file_type == 2){
+			if(mark_file_blocks(current.inode_num) == -1)
+				return -1;
+		} else if(dentry_is_dir(&current)){
+			if(mark_file_blocks(current.inode_num) == -1 || mark_dir_blocks(current.inode_num, depth + 1) == -1)
+				return -1;
+		}
+		/* RTC dentries and "." don't own an inode */
+	}
+	return 0;
+}
+
+/*
+ * int32_t fs_bitmap_init()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: 0 (success), -1 if the image is too big or points at bad blocks
+ * Side Effects: Marks every inode referenced by a regular file or directory and every
+ *				 datablock inside their lengths as in use
+ */
+int32_t fs_bitmap_init()
+{
+	if(boot_block->inode_count > FS_MAX_INODES || boot_block->data_count > FS_MAX_DATA_BLOCKS)
+		return -1;
+
+	memset(inode_bitmap, 0, sizeof(inode_bitmap));
+	memset(data_bitmap, 0, sizeof(data_bitmap));
+
+	return mark_dir_blocks(ROOT_DIR, 0);
+}
+
+/*
+ * int32_t alloc_inode()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: number of a free inode, now marked in use, -1 if there are none
+ * Side Effects: None
+ */
+static int32_t alloc_inode()
+{
+	uint32_t inode;
+	for(inode = 0; inode < boot_block->inode_count; inode++){
+		if(!bitmap_test(inode_bitmap, inode)){
+			bitmap_set(inode_bitmap, inode);
+			return inode;
+		}
+	}
+	return -1;
+}
+
+/*
+ * int32_t alloc_data_block(int32_t prev)
+ * Inputs: int32_t prev - datablock that comes before the new one in the file, -1 if none
+ * Outputs: None
+ * Return Value: number of a free datablock, now marked in use and zeroed, -1 if there are none
+ * Side Effects: None
+ * Keeps files contiguous where it can: the block right after prev is used if it is free,
+ * otherwise the start of the longest free run, so the file has the most room to grow.
+ */
+static int32_t alloc_data_block(int32_t prev)
+{
+	uint32_t block, run_start = 0, run_len = 0;
+	int32_t best = -1;
+	uint32_t best_len = 0;
+
+	if(prev >= 0 && prev + 1 < boot_block->data_count && !bitmap_test(data_bitmap, prev + 1)){
+		best = prev + 1;
+	} else {
+		for(block = 0; block < boot_block->data_count; block++){
+			if(bitmap_test(data_bitmap, block)){
+				run_len = 0;
+				continue;
+			}
+			if(run_len == 0)
+				run_start = block;
+			run_len++;
+			if(run_len > best_len){
+				best = run_start;
+				best_len = run_len;
+			}
+		}
+		if(best == -1)
+			return -1;
+	}
+	bitmap_set(data_bitmap, best);
+	memset((uint8_t*)(data_block_start + best * ABS_BLOCK_SIZE), 0, ABS_BLOCK_SIZE);
+	return best;
+}
+
+/*
+ * void dentry_hash_init()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Fills dentry_hash with the index of every dentry in the boot block
+ */
+void dentry_hash_init()
+{
+	uint32_t dir_entry_idx, slot;
+	int32_t num_dir_entries = boot_block->dir_count;
+
+	if(num_dir_entries > NUM_FILES)
+		num_dir_entries = NUM_FILES;
+
+	for(slot = 0; slot < DENTRY_HASH_SIZE; slot++)
+		dentry_hash[slot] = DENTRY_HASH_EMPTY;
+
+	for(dir_entry_idx = 0; dir_entry_idx < num_dir_entries; dir_entry_idx++)
+		dentry_hash_insert(dir_entry_idx);
+}
+
+/*
+ * void dentry_hash_insert(uint32_t dir_entry_idx)
+ * Inputs: uint32_t dir_entry_idx - index of the dentry in the boot block
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Adds the dentry's name to dentry_hash
+ */
+void dentry_hash_insert(uint32_t dir_entry_idx)
+{
+	uint32_t slot;
+
+	slot = dentry_hash_name((uint8_t*)boot_block->dir_entries[dir_entry_idx].file_name) & (DENTRY_HASH_SIZE - 1);
+	while(dentry_hash[slot] != DENTRY_HASH_EMPTY)
+		slot = (slot + 1) & (DENTRY_HASH_SIZE - 1);
+	dentry_hash[slot] = dir_entry_idx;
+}
+
+/*
+ * uint32_t dcache_slot(uint32_t parent, const uint8_t* fname)
+ * Inputs: uint32_t parent - directory inode
+ * 		   const uint8_t* fname - name within the directory
+ * Outputs: None
+ * Return Value: index in dcache the pair maps to
+ * Side Effects: None
+ */
+static inline uint32_t dcache_slot(uint32_t parent, const uint8_t* fname)
+{
+	return (dentry_hash_name(fname) ^ (parent * 2654435761U)) & (DCACHE_SIZE - 1);
+}
+
+/*
+ * int32_t dir_lookup(uint32_t dir, const uint8_t* fname, dentry_t* dentry)
+ * Inputs: uint32_t dir - directory inode, ROOT_DIR for the boot block directory
+ * 		   const uint8_t* fname - single path component, at most FILENAME_LEN chars
+ * 		   dentry_t* dentry - dentry_t struct to write to
+ * Outputs: None
+ * Return Value: 0 if the name is in the directory, -1 otherwise
+ * Side Effects: Directories in datablocks are scanned on a dcache miss and the
+ *				 dentry found is cached
+ */
+static int32_t dir_lookup(uint32_t dir, const uint8_t* fname, dentry_t* dentry)
+{
+	uint32_t slot, dir_entry_idx;
+	int8_t hash_idx;
+	dentry_t* current;
+	dcache_entry_t* cached;
+
+	if(dir == ROOT_DIR){
+		/* Walk the probe chain for this name until we hit an empty slot */
+		slot = dentry_hash_name(fname) & (DENTRY_HASH_SIZE - 1);
+		while((hash_idx = dentry_hash[slot]) != DENTRY_HASH_EMPTY){
+			current = &boot_block->dir_entries[(uint8_t)hash_idx];
+			if(strncmp((int8_t*)current->file_name,(int8_t*)fname, FILENAME_LEN) == 0)
+				return read_dentry_by_index(hash_idx, dentry);
+			slot = (slot + 1) & (DENTRY_HASH_SIZE - 1);
+		}
+		return -1;
+	}
+
+	cached = &dcache[dcache_slot(dir, fname)];
+	if(cached->valid && cached->parent == dir
+		&& strncmp((int8_t*)cached->dentry.file_name, (int8_t*)fname, FILENAME_LEN) == 0){
+		memcpy(dentry, &cached->dentry, sizeof(dentry_t));
+		return 0;
+	}
+
+	for(dir_entry_idx = 0; read_dentry_in_dir(dir, dir_entry_idx, dentry) == 0; dir_entry_idx++){
+		if(strncmp((int8_t*)dentry->file_name, (int8_t*)fname, FILENAME_LEN) == 0){
+			cached->parent = dir;
+			cached->valid = 1;
+			memcpy(&cached->dentry, dentry, sizeof(dentry_t));
+			return 0;
+		}
+	}
+	return -1;
 }
 
 /* Function: read_dentry_by_name
- * Description: searches filesystem for a file by its file name and copies its dentry
+ * Description: resolves a '/' separated path from the root directory and copies the
+ *				dentry of its last component. Each directory on the way is looked up
+ *				through the boot block index or the dentry cache.
  * Inputs:
- * 	fname - name of file to search for
+ * 	fname - path of file to search for, a plain name is looked up in the root directory
  *	dentry - dentry_t struct to write to
  * Outputs:	returns 0 if dentry was copied, otherwise -1 is returned.
  * Side Effects: dentry for file is copied to dentry input
@@ -31,27 +642,34 @@ void fs_init(module_t* file_sys_boot){
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry)
 {
 	/* Initialize Variables used */
-	int32_t num_dir_entries;
-	uint32_t dir_entry_idx;
-	dentry_t* current;
-	int32_t match;
-	/* Set current to point to the first fname in the current directory entry */
-	current = &boot_block->dir_entries[0];
-	/* Set the number of directory entries count for looping */
-	num_dir_entries = boot_block->dir_count;
-	/* Scan through all the dir entries in the bootlock */
-	for(dir_entry_idx = 0; dir_entry_idx < num_dir_entries; dir_entry_idx++){
-		/* Go through all dir entries and find the fname that matches the given input's */
-		match = 0;
-		match = strncmp((int8_t*)current->file_name,(int8_t*)fname, FILENAME_LEN);
-		if(match == 0){
-			read_dentry_by_index(dir_entry_idx, dentry);
-			return 0;
+	uint8_t component[FILENAME_LEN + 1];
+	uint32_t dir = ROOT_DIR, len;
+	if(fname == NULL || fname[0] == '\0')
+		return -1;
+	while(*fname == '/')
+		fname++;
+	if(*fname == '\0')
+		return -1;
+	while(*fname != '\0'){
+		/* names filling all 32 bytes are stored without a null terminator, so compare 32 at most */
+		for(len = 0; fname[len] != '/' && fname[len] != '\0'; len++){
+			if(len < FILENAME_LEN)
+				component[len] = fname[len];
+		}
+		component[len < FILENAME_LEN ? len : FILENAME_LEN] = '\0';
+		if(dir_lookup(dir, component, dentry) == -1)
+			return -1;
+		fname += len;
+		while(*fname == '/')
+			fname++;
+		/* every component but the last has to be a directory */
+		if(*fname != '\0'){
+			if(dentry->file_type != 1)
+				return -1;
+			dir = dentry_dir_inode(dentry);
 		}
-		current++;	// increment current to point to next fname
 	}
-	// Return -1 if the fnames do not match
-	return -1; 
+	return 0;
 }
 
 /* Function: read_dentry_by_index
@@ -64,14 +682,41 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry)
  */
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry)
 {
-	/* Else call memcpy to populate the dentry parameters */
+	return read_dentry_in_dir(ROOT_DIR, index, dentry);
+}
 
-	//strlen((int8_t*)&boot_block->dir_entries[index])
-	if(index < 0 || index >= boot_block->dir_count){
-		return -1;
+/*
+ * int32_t read_dentry_in_dir(uint32_t dir, uint32_t index, dentry_t* dentry)
+ * Inputs: uint32_t dir - directory inode, ROOT_DIR for the boot block directory
+ * 		   uint32_t index - position of the dentry in the directory
+ * 		   dentry_t* dentry - dentry_t struct to write to
+ * Outputs: None
+ * Return Value: 0 if dentry was copied, -1 past the end of the directory
+ * Side Effects: dentry is copied to the dentry input
+ */
+int32_t read_dentry_in_dir(uint32_t dir, uint32_t index, dentry_t* dentry)
+{
+	dentry_t* current_dentry;
+	dentry_t block_dentry;
+	uint32_t run_len;
+	int32_t data_block;
+
+	if(dir == ROOT_DIR){
+		if(index >= boot_block->dir_count || index >= NUM_FILES)
+			return -1;
+		// get the current dentry we want to read
+		current_dentry = &boot_block->dir_entries[index];
+	} else {
+		/* a directory's datablocks hold its dentries back to back, 64 per block */
+		if(get_inode_length(dir) == -1 || index >= get_inode_length(dir) / sizeof(dentry_t))
+			return -1;
+		if((data_block = inode_run(dir, index / DENTRIES_PER_BLOCK, &run_len)) == -1)
+			return -1;
+		if(copy_data_blocks(data_block, (index % DENTRIES_PER_BLOCK) * sizeof(dentry_t),
+			(uint8_t*)&block_dentry, sizeof(dentry_t)) == -1)
+			return -1;
+		current_dentry = &block_dentry;
 	}
-	// get the current dentry we want to read
-	dentry_t* current_dentry = &boot_block->dir_entries[index];
 	// fill in the paramter values for dentry struct
 	strncpy(dentry->file_name, current_dentry->file_name,FILENAME_LEN);
 	dentry->file_type = current_dentry->file_type;
@@ -80,59 +725,197 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry)
 	return 0;
 }
 
+/*
+ * int32_t dentry_is_dir(const dentry_t* dentry)
+ * Inputs: const dentry_t* dentry - dentry to check
+ * Outputs: None
+ * Return Value: 1 if the dentry is a subdirectory with its own inode, 0 otherwise
+ * Side Effects: None
+ */
+int32_t dentry_is_dir(const dentry_t* dentry)
+{
+	/* "." is the root directory itself, its inode_num means nothing */
+	return dentry->file_type == 1 && strncmp((int8_t*)dentry->file_name, ".", FILENAME_LEN) != 0;
+}
+
+/*
+ * uint32_t dentry_dir_inode(const dentry_t* dentry)
+ * Inputs: const dentry_t* dentry - dentry of a directory
+ * Outputs: None
+ * Return Value: inode holding the directory's dentries, ROOT_DIR for "."
+ * Side Effects: None
+ */
+uint32_t dentry_dir_inode(const dentry_t* dentry)
+{
+	return dentry_is_dir(dentry) ? (uint32_t)dentry->inode_num : ROOT_DIR;
+}
+
 /*
  * int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length)
  * Inputs: an inode num, offset = where to start reading from, buf = buffer to write to,length= position to read until
  * Outputs: none 
- * Return Value: bytes read into buffer
- * Side Effects: Reads in the data from the filesystem memory
+ * Return Value: bytes read into buffer, -1 if the inode points at a bad data block
+ * Side Effects: Reads in the data from the filesystem memory, one run of contiguous
+ *				 datablocks at a time (one datablock at a time from a compressed image)
  */
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
 
 	// Initialize all FileSystem address variables 
-	uint32_t data_bytes,datablock,byte_offset;
-	uint8_t* curr_datablock_loc;
+	uint32_t datablock, byte_offset, span, bytes_read, run_len;
+	int32_t data_block;
 	inode_t* curr_inode;
-	int i;
 	// Check if given inode number is invalid 
-	if( inode < 0 || inode >= boot_block->inode_count)
+	if(inode >= boot_block->inode_count)
 		return 0;
 	// Current Inode pointer
 	curr_inode = (inode_t*)(boot_block_end + (inode * ABS_BLOCK_SIZE));
+	// Nothing left to read past the end of the file
+	if(offset >= curr_inode->length)
+		return 0;
+	// Clamp the request to the end of the file once, instead of per byte
+	if(length > curr_inode->length - offset)
+		length = curr_inode->length - offset;
 	// index to get datablock number from the current inode 
-	datablock  = offset / ABS_BLOCK_SIZE;			
-	// how many bytes to start from in each datablock 
-	byte_offset = offset % ABS_BLOCK_SIZE;	
-	//	compute Current Datablock's location start 
-	curr_datablock_loc = (uint8_t*) (data_block_start + (curr_inode->data_block[datablock] * ABS_BLOCK_SIZE) + byte_offset);
-	// Initialize the number of bytes to copy to buffer to be ABS_BLOCK_SIZE, unless changed 
-	data_bytes = ABS_BLOCK_SIZE;
-	for(i = 0; i < length; i ++){
-		// Check if we have reached end of current inode
-		if(i + offset >= curr_inode->length ) {
-			return i;
-		}	
-		// Check if we have reached end of a datablock
-		if(byte_offset >= data_bytes) {
-			// go to next datablock
-			datablock++;
-			// reset byte offset at beginning of each datablock
-			byte_offset = 0;
-			//compute the address of the datablock's data and also factor in an offset to determine how many bytes of the datablock we should copy
-			curr_datablock_loc = (uint8_t *)(data_block_start + (curr_inode->data_block[datablock] * data_bytes));
-		}
-		// Copy over specified amount of bytes to the buffer 
-		buf[i] = *curr_datablock_loc;
-		// move ptr to get address of next datablock 
-		curr_datablock_loc++;
-		//increment byte offset
-		byte_offset++;
+	datablock = offset / ABS_BLOCK_SIZE;
+	// how many bytes to start from in the first datablock 
+	byte_offset = offset % ABS_BLOCK_SIZE;
+	bytes_read = 0;
+	while(bytes_read < length){
+		// find the run holding this datablock, which also checks it is a real datablock
+		if((data_block = inode_run(inode, datablock, &run_len)) == -1)
+			return -1;
+		// compressed datablocks are decompressed one at a time
+		if(fs_compressed)
+			run_len = 1;
+		// copy up to the end of this run or the end of the request, whichever comes first
+		span = run_len * ABS_BLOCK_SIZE - byte_offset;
+		if(span > length - bytes_read)
+			span = length - bytes_read;
+		if(copy_data_blocks(data_block, byte_offset, buf + bytes_read, span) == -1)
+			return -1;
+		bytes_read += span;
+		// every run after the first is read from its beginning
+		datablock += run_len;
+		byte_offset = 0;
 	}
 
-	return i;
+	return bytes_read;
 
 }
 
+/*
+ * int32_t get_inode_length(uint32_t inode)
+ * Inputs: uint32_t inode - inode number
+ * Outputs: None
+ * Return Value: length of the file in bytes, -1 if the inode number is invalid
+ * Side Effects: None
+ */
+int32_t get_inode_length(uint32_t inode)
+{
+	if(inode >= boot_block->inode_count)
+		return -1;
+	return ((inode_t*)(boot_block_end + (inode * ABS_BLOCK_SIZE)))->length;
+}
+
+/*
+ * uint32_t get_inode_generation(uint32_t inode)
+ * Inputs: uint32_t inode - inode number
+ * Outputs: None
+ * Return Value: counter that changes whenever the file is written, truncated or its
+ *				 inode reused, so caches of file contents can tell they are stale
+ * Side Effects: None
+ */
+uint32_t get_inode_generation(uint32_t inode)
+{
+	if(inode >= FS_MAX_INODES)
+		return 0;
+	return inode_generation[inode];
+}
+
+/*
+ * void inode_exec_retain(uint32_t inode)
+ * Inputs: uint32_t inode - program file a process region is read from
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: write_data and truncate_data refuse the inode until it is put back,
+ *				 pages still to be faulted in have to match the ones already mapped
+ */
+void inode_exec_retain(uint32_t inode)
+{
+	uint32_t flags;
+
+	if(inode >= FS_MAX_INODES)
+		return;
+	cli_and_save(flags);
+	inode_exec_users[inode]++;
+	restore_flags(flags);
+}
+
+/*
+ * void inode_exec_put(uint32_t inode)
+ * Inputs: uint32_t inode - program file from inode_exec_retain
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void inode_exec_put(uint32_t inode)
+{
+	uint32_t flags;
+
+	if(inode >= FS_MAX_INODES)
+		return;
+	cli_and_save(flags);
+	inode_exec_users[inode]--;
+	restore_flags(flags);
+}
+
+/*
+ * void fill_stat(int32_t file_type, uint32_t inode, stat_t* st)
+ * Inputs: int32_t file_type - dentry_t file type of the file
+ * 		   uint32_t inode - inode number, only used for regular files
+ * 		   stat_t* st - struct to fill in
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void fill_stat(int32_t file_type, uint32_t inode, stat_t* st)
+{
+	int32_t length;
+
+	st->file_type = file_type;
+	st->inode_num = 0;
+	st->length = 0;
+	/* only regular files have an inode */
+	if(file_type == 2 && (length = get_inode_length(inode)) != -1){
+		st->inode_num = inode;
+		st->length = length;
+	}
+}
+
+/*
+ * uint32_t get_data_block_addr(uint32_t inode, uint32_t block)
+ * Inputs: uint32_t inode - inode number
+ * 		   uint32_t block - index of the datablock within the file
+ * Outputs: None
+ * Return Value: address of the 4KB datablock, 0 if the inode or block is invalid or the
+ *				 image is compressed (its datablocks aren't anywhere in memory as they are)
+ * Side Effects: None
+ */
+uint32_t get_data_block_addr(uint32_t inode, uint32_t block)
+{
+	inode_t* curr_inode;
+	uint32_t run_len;
+	int32_t data_block;
+	if(fs_compressed || inode >= boot_block->inode_count || block >= DATABLOCK_SIZE)
+		return 0;
+	curr_inode = (inode_t*)(boot_block_end + (inode * ABS_BLOCK_SIZE));
+	if(block * ABS_BLOCK_SIZE >= curr_inode->length)
+		return 0;
+	if((data_block = inode_run(inode, block, &run_len)) == -1)
+		return 0;
+	return data_block_start + (data_block * ABS_BLOCK_SIZE);
+}
+
 
 /*
  * int32_t read_file(int32_t fd, void* buf, int32_t nbytes)
@@ -153,6 +936,8 @@ int32_t read_file(int32_t fd, void* buf, int32_t nbytes)
 	int32_t nbytes_read;
 
 	nbytes_read = read_data(current_process->file[fd].inode, current_process->file[fd].pos, buf, nbytes);
+	if(nbytes_read == -1)
+		return -1;
 
 	current_process->file[fd].pos += nbytes_read;
 
@@ -166,12 +951,255 @@ int32_t read_file(int32_t fd, void* buf, int32_t nbytes)
  * 			void* buf - buffer to write
  * 			int32_t nbytes - number of bytes to write
  * Outputs: None
- * Return Value: bytes read into buffer
- * Side Effects: Reads a buf and write the output
+ * Return Value: bytes written, -1 (read-only or out of space)
+ * Side Effects: Writes buf at the fd position, growing the file when it runs past the end
+ * 				 (so writing after lseek to the end appends), and advances the position
  */
 int32_t write_file(int32_t fd, const void* buf, int32_t nbytes)
 {
-	return -1;
+	pcb_t* current_process = get_pcb_address();
+	int32_t nbytes_written;
+
+	nbytes_written = write_data(current_process->file[fd].inode, current_process->file[fd].pos, buf, nbytes);
+	if(nbytes_written == -1)
+		return -1;
+
+	current_process->file[fd].pos += nbytes_written;
+
+	return nbytes_written;
+}
+
+/*
+ * int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length)
+ * Inputs: an inode num, offset = where to start writing, buf = data to write, length = bytes to write
+ * Outputs: none
+ * Return Value: bytes written, -1 if nothing could be written or a running program is
+ *				 read from the file
+ * Side Effects: Copies buf into the file's datablocks one span at a time, allocating
+ * 				 new datablocks (contiguous with the previous one when possible) past the end
+ */
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length)
+{
+	uint32_t datablock, byte_offset, span, bytes_written, flags, run_len;
+	int32_t data_block, prev_block = -1;
+	uint8_t grew = 0;
+	inode_t* curr_inode;
+
+	if(!fs_writable || inode >= boot_block->inode_count || !bitmap_test(inode_bitmap, inode))
+		return -1;
+	// a running program faults its pages in from the file, they can't change under it
+	if(inode_exec_users[inode] != 0)
+		return -1;
+	curr_inode = get_inode(inode);
+	// writes can extend a file but not leave a hole in it
+	if(offset > curr_inode->length || offset >= MAX_FILE_LEN)
+		return -1;
+	if(length > MAX_FILE_LEN - offset)
+		length = MAX_FILE_LEN - offset;
+
+	cli_and_save(flags);
+	inode_generation[inode]++;
+	datablock = offset / ABS_BLOCK_SIZE;
+	byte_offset = offset % ABS_BLOCK_SIZE;
+	bytes_written = 0;
+	while(bytes_written < length){
+		if(datablock >= FILE_BLOCKS(curr_inode->length)){
+			// past the last datablock of the file, give it a new one
+			if(prev_block == -1 && datablock > 0)
+				prev_block = inode_run(inode, datablock - 1, &run_len);
+			data_block = alloc_data_block(prev_block);
+			if(data_block == -1)
+				break;
+			if(inode_append_block(inode, datablock, data_block) == -1){
+				bitmap_clear(data_bitmap, data_block);
+				break;
+			}
+			grew = 1;
+		} else if((data_block = inode_run(inode, datablock, &run_len)) == -1){
+			break;
+		}
+		span = ABS_BLOCK_SIZE - byte_offset;
+		if(span > length - bytes_written)
+			span = length - bytes_written;
+		memcpy((uint8_t*)(data_block_start + (data_block * ABS_BLOCK_SIZE) + byte_offset),
+			buf + bytes_written, span);
+		bytes_written += span;
+		if(offset + bytes_written > curr_inode->length)
+			curr_inode->length = offset + bytes_written;
+		prev_block = data_block;
+		datablock++;
+		byte_offset = 0;
+	}
+	// the new datablocks were added to the block list only, collapse it into runs again
+	if(grew)
+		reindex_inode_runs(inode);
+	restore_flags(flags);
+
+	if(bytes_written == 0 && length != 0)
+		return -1;
+	return bytes_written;
+}
+
+/*
+ * int32_t truncate_data(uint32_t inode, uint32_t length)
+ * Inputs: uint32_t inode - inode number
+ * 		   uint32_t length - new length of the file
+ * Outputs: None
+ * Return Value: 0 (success), -1 (read-only, bad length, out of space, a datablock
+ *				 that would be freed is mapped by mmap, or a running program is read from the file)
+ * Side Effects: Shrinking frees the datablocks past the new end, growing fills the
+ * 				 new part of the file with zeroes
+ */
+int32_t truncate_data(uint32_t inode, uint32_t length)
+{
+	uint32_t block, old_length, flags, run_len;
+	int32_t data_block, prev_block;
+	inode_t* curr_inode;
+
+	if(!fs_writable || inode >= boot_block->inode_count || !bitmap_test(inode_bitmap, inode))
+		return -1;
+	if(length > MAX_FILE_LEN || inode_exec_users[inode] != 0)
+		return -1;
+	curr_inode = get_inode(inode);
+	old_length = curr_inode->length;
+
+	cli_and_save(flags);
+	if(length < old_length){
+		// mappings have no munmap, a freed datablock would show the next file to get it
+		for(block = FILE_BLOCKS(length); block < FILE_BLOCKS(old_length); block++){
+			if((data_block = inode_run(inode, block, &run_len)) != -1
+				&& mmap_page_mapped(data_block_start + (data_block * ABS_BLOCK_SIZE))){
+				restore_flags(flags);
+				return -1;
+			}
+		}
+		for(block = FILE_BLOCKS(length); block < FILE_BLOCKS(old_length); block++){
+			if((data_block = inode_run(inode, block, &run_len)) != -1)
+				bitmap_clear(data_bitmap, data_block);
+		}
+	} else if(length > old_length){
+		// zero what was past the old end in the last datablock
+		if(old_length % ABS_BLOCK_SIZE != 0 && (data_block = inode_run(inode, old_length / ABS_BLOCK_SIZE, &run_len)) != -1)
+			memset((uint8_t*)(data_block_start + (data_block * ABS_BLOCK_SIZE)
+				+ (old_length % ABS_BLOCK_SIZE)), 0, ABS_BLOCK_SIZE - (old_length % ABS_BLOCK_SIZE));
+		// new datablocks come back zeroed
+		prev_block = FILE_BLOCKS(old_length) > 0 ? inode_run(inode, FILE_BLOCKS(old_length) - 1, &run_len) : -1;
+		for(block = FILE_BLOCKS(old_length); block < FILE_BLOCKS(length); block++){
+			data_block = alloc_data_block(prev_block);
+			if(data_block != -1 && inode_append_block(inode, block, data_block) == -1){
+				bitmap_clear(data_bitmap, data_block);
+				data_block = -1;
+			}
+			if(data_block == -1){
+				// give back what was taken so the file is left as it was
+				curr_inode->length = block * ABS_BLOCK_SIZE;
+				reindex_inode_runs(inode);
+				while(block-- > FILE_BLOCKS(old_length)){
+					if((data_block = inode_run(inode, block, &run_len)) != -1)
+						bitmap_clear(data_bitmap, data_block);
+				}
+				curr_inode->length = old_length;
+				inode_trim_blocks(inode, FILE_BLOCKS(old_length));
+				restore_flags(flags);
+				return -1;
+			}
+			prev_block = data_block;
+		}
+	}
+	curr_inode->length = length;
+	inode_trim_blocks(inode, FILE_BLOCKS(length));
+	inode_generation[inode]++;
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+ * int32_t truncate_file(int32_t fd, int32_t length)
+ * Inputs: int32_t fd - file descriptor of an open regular file
+ * 		   int32_t length - new length of the file
+ * Outputs: None
+ * Return Value: 0 (success), -1 (failure)
+ * Side Effects: The fd position is pulled back to the new end if it was past it
+ */
+int32_t truncate_file(int32_t fd, int32_t length)
+{
+	pcb_t* current_process = get_pcb_address();
+
+	if(length < 0 || truncate_data(current_process->file[fd].inode, length) == -1)
+		return -1;
+	if(current_process->file[fd].pos > length)
+		current_process->file[fd].pos = length;
+	return 0;
+}
+
+/*
+ * int32_t create_file(const uint8_t* filename)
+ * Inputs: const uint8_t* filename - path of the new file, its directory has to exist
+ * Outputs: None
+ * Return Value: 0 (success), -1 (read-only, bad or taken name, or no free dentry/inode)
+ * Side Effects: Adds an empty regular file to its directory, root dentries also go
+ *				 into the name index
+ */
+int32_t create_file(const uint8_t* filename)
+{
+	dentry_t dentry;
+	dentry_t* new_dentry;
+	uint8_t parent[PATH_LEN + 1];
+	const uint8_t* name;
+	int32_t inode, dir_length;
+	uint32_t dir = ROOT_DIR, len, flags;
+
+	if(!fs_writable || filename == NULL)
+		return -1;
+	len = strlen((int8_t*)filename);
+	if(len == 0 || len > PATH_LEN)
+		return -1;
+	/* split off the directory part and find the directory */
+	for(name = filename + len; name > filename && *(name - 1) != '/'; name--);
+	if(name != filename){
+		strncpy((int8_t*)parent, (int8_t*)filename, name - filename);
+		parent[name - filename] = '\0';
+		if(read_dentry_by_name(parent, &dentry) == -1 || dentry.file_type != 1)
+			return -1;
+		dir = dentry_dir_inode(&dentry);
+	}
+	len = strlen((int8_t*)name);
+	if(len == 0 || len > FILENAME_LEN)
+		return -1;
+	if(dir_lookup(dir, name, &dentry) == 0)
+		return -1;
+
+	cli_and_save(flags);
+	if((dir == ROOT_DIR && boot_block->dir_count >= NUM_FILES) || (inode = alloc_inode()) == -1){
+		restore_flags(flags);
+		return -1;
+	}
+	get_inode(inode)->length = 0;
+	inode_trim_blocks(inode, 0);
+	inode_generation[inode]++;
+	if(dir == ROOT_DIR){
+		new_dentry = &boot_block->dir_entries[boot_block->dir_count];
+	} else {
+		new_dentry = &dentry;
+	}
+	memset(new_dentry, 0, sizeof(dentry_t));
+	strncpy(new_dentry->file_name, (int8_t*)name, FILENAME_LEN);
+	new_dentry->file_type = 2;
+	new_dentry->inode_num = inode;
+	if(dir == ROOT_DIR){
+		dentry_hash_insert(boot_block->dir_count);
+		boot_block->dir_count++;
+	} else {
+		/* datablock directories grow like files, one dentry appended at the end */
+		dir_length = get_inode_length(dir);
+		if(write_data(dir, dir_length, (uint8_t*)&dentry, sizeof(dentry_t)) != sizeof(dentry_t)){
+			bitmap_clear(inode_bitmap, inode);
+			restore_flags(flags);
+			return -1;
+		}
+	}
+	restore_flags(flags);
+	return 0;
 }
 
 /*
@@ -213,6 +1241,78 @@ int32_t open_file(const uint8_t* filename)
 	return -1;
 	
 }
+/*
+ * int32_t lseek_file(int32_t fd, int32_t offset, int32_t whence)
+ * Inputs: int32_t fd - file descriptor of an open regular file
+ * 		   int32_t offset - offset relative to whence
+ * 		   int32_t whence - SEEK_SET, SEEK_CUR or SEEK_END
+ * Outputs: None
+ * Return Value: new position, -1 if it would land before the start or past the end of the file
+ * Side Effects: moves the fd position
+ */
+int32_t lseek_file(int32_t fd, int32_t offset, int32_t whence)
+{
+	pcb_t* cur_process = get_pcb_address();
+	int32_t length = get_inode_length(cur_process->file[fd].inode);
+	int32_t pos;
+
+	if(length == -1)
+		return -1;
+	pos = seek_position(cur_process->file[fd].pos, length, offset, whence);
+	if(pos == -1)
+		return -1;
+
+	cur_process->file[fd].pos = pos;
+	return pos;
+}
+
+/*
+ * int32_t seek_position(uint32_t pos, int32_t length, int32_t offset, int32_t whence)
+ * Inputs: uint32_t pos - current position
+ * 		   int32_t length - length of the file
+ * 		   int32_t offset - offset relative to whence
+ * 		   int32_t whence - SEEK_SET, SEEK_CUR or SEEK_END
+ * Outputs: None
+ * Return Value: the position lseek moves to, -1 if it would land before the start or
+ *				 past the end of the file
+ * Side Effects: None
+ */
+int32_t seek_position(uint32_t pos, int32_t length, int32_t offset, int32_t whence)
+{
+	int32_t base;
+
+	if(whence == SEEK_SET)
+		base = 0;
+	else if(whence == SEEK_CUR)
+		base = pos;
+	else if(whence == SEEK_END)
+		base = length;
+	else
+		return -1;
+
+	/* the same bounds read_data enforces: 0 through the end of the file */
+	if((offset < 0 && -offset > base) || (offset > 0 && offset > length - base))
+		return -1;
+	return base + offset;
+}
+
+/*
+ * int32_t pread_file(int32_t fd, void* buf, int32_t nbytes, uint32_t offset)
+ * Inputs: int32_t fd - file descriptor of an open regular file
+ * 		   void* buf - buffer to read into
+ * 		   int32_t nbytes - number of bytes to read
+ * 		   uint32_t offset - file offset to read from
+ * Outputs: None
+ * Return Value: bytes read into buffer, -1 on a bad datablock
+ * Side Effects: None, the fd position is left where it was
+ */
+int32_t pread_file(int32_t fd, void* buf, int32_t nbytes, uint32_t offset)
+{
+	pcb_t* current_process = get_pcb_address();
+
+	return read_data(current_process->file[fd].inode, offset, buf, nbytes);
+}
+
 int32_t read_dir_idx = 0;
 /*
  * int32_t read_dir(int32_t fd, void* buf, int32_t nbytes)
@@ -241,7 +1341,7 @@ int32_t read_dir(int32_t fd, void* buf, int32_t nbytes)
     int i = 0;
 	pcb_t* cur_process = get_pcb_address();
 
-    if(read_dentry_by_index(cur_process->file[fd].pos, &dentry) == 0){
+    if(read_dentry_in_dir(cur_process->file[fd].inode, cur_process->file[fd].pos, &dentry) == 0){
 		
         for(i = 0; i < FILENAME_LEN +1; i++){
             ((int8_t*)(buf))[i] = '\0';
@@ -261,6 +1361,39 @@ int32_t read_dir(int32_t fd, void* buf, int32_t nbytes)
     }
 }
 
+/*
+ * int32_t read_dirents(int32_t fd, void* buf, int32_t nbytes)
+ * Inputs: int32_t fd - file descriptor of an open directory
+ * 		   void* buf - buffer to fill with dirent_t records
+ * 		   int32_t nbytes - size of buf in bytes
+ * Outputs: None
+ * Return Value: number of bytes of records written, 0 once every dentry has been returned
+ * Side Effects: advances the directory position past the returned dentries
+ */
+int32_t read_dirents(int32_t fd, void* buf, int32_t nbytes)
+{
+	dentry_t dentry;
+	dirent_t* record = (dirent_t*)buf;
+	stat_t st;
+	int32_t nbytes_read = 0;
+	pcb_t* cur_process = get_pcb_address();
+
+	/* fill in as many whole records as fit */
+	while(nbytes - nbytes_read >= (int32_t)sizeof(dirent_t)
+		&& read_dentry_in_dir(cur_process->file[fd].inode, cur_process->file[fd].pos, &dentry) == 0){
+		memset(record, 0, sizeof(dirent_t));
+		strncpy(record->file_name, dentry.file_name, FILENAME_LEN);
+		fill_stat(dentry.file_type, dentry.inode_num, &st);
+		record->file_type = st.file_type;
+		record->inode_num = st.inode_num;
+		record->length = st.length;
+		cur_process->file[fd].pos++;
+		nbytes_read += sizeof(dirent_t);
+		record++;
+	}
+	return nbytes_read;
+}
+
 /* 
  * int32_t write_dir(int32_t fd, const void* buf, int32_t nbytes)
  * Inputs:  int32_t fd - file descriptor
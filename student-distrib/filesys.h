@@ -23,7 +23,26 @@
 #define NUM_FILES 63
 #define DATABLOCK_SIZE 1023
 #define RESERVE1 24
-#define RESERVE2 52
+#define RESERVE2 44				/* 52B reserved in the original format, less the format and compression fields */
+#define DENTRY_HASH_SIZE 128		/* power of two, at least 2x NUM_FILES so probe chains stay short */
+#define DENTRY_HASH_EMPTY -1
+#define FS_WRITABLE					/* comment out to keep the filesystem image read-only */
+#define FS_MAX_INODES 1024			/* largest inode_count writable mode can track */
+#define FS_MAX_DATA_BLOCKS 32768	/* largest data_count writable mode can track (128MB) */
+#define MAX_FILE_LEN (DATABLOCK_SIZE * ABS_BLOCK_SIZE)
+#define SEEK_SET 0					/* lseek from the start of the file */
+#define SEEK_CUR 1					/* lseek from the current position */
+#define SEEK_END 2					/* lseek from the end of the file */
+#define PATH_LEN 128				/* longest path open/stat/execute accept, '/' separated */
+#define ROOT_DIR 0xFFFFFFFF			/* the root directory lives in the boot block, not an inode */
+#define DENTRIES_PER_BLOCK 64		/* ABS_BLOCK_SIZE / sizeof(dentry_t) */
+#define DCACHE_SIZE 64				/* power of two, entries in the (parent, name) dentry cache */
+#define DIR_MAX_DEPTH 8				/* deepest directory nesting fs_bitmap_init will follow */
+#define FS_FORMAT_EXTENT 0x31545845	/* "EXT1" in the boot block format field, inodes hold extents */
+#define EXTENTS_PER_INODE 511		/* (ABS_BLOCK_SIZE - 8) / sizeof(extent_t) */
+#define FS_RUN_POOL 4096			/* runs the mount-time index of block list inodes can hold */
+#define FS_COMPRESS_LZ4 0x20345a4c	/* "LZ4 " in the boot block compression field, datablocks are LZ4 blocks */
+#define BLOCK_CACHE_SLOTS 16		/* decompressed datablocks kept around for partial reads */
 #ifndef ASM		// ASM
 
 /* Directory Entry data structure */
@@ -40,11 +59,61 @@ typedef struct inode {
 		int32_t data_block[DATABLOCK_SIZE];			// 
 } inode_t;
 
+/* Run of datablocks, contiguous both in the file and in the image */
+typedef struct extent {
+		uint32_t start;					/* first datablock of the run */
+		uint32_t count;					/* number of datablocks in the run */
+} extent_t;
+
+/* Index node in FS_FORMAT_EXTENT images, the file's datablocks as runs in file order */
+typedef struct extent_inode {
+		int32_t length;					/* same place as in inode_t */
+		int32_t extent_count;
+		extent_t extents[EXTENTS_PER_INODE];
+} extent_inode_t;
+
+/* Where a block list inode's runs are in the run pool built at mount */
+typedef struct run_index {
+		uint16_t first;					/* index of the first run in the pool */
+		uint16_t count;					/* 0 if the inode isn't indexed */
+} run_index_t;
+
+/* Slot of the decompressed datablock cache */
+typedef struct block_cache {
+		int32_t data_block;				/* datablock held in the slot, -1 if empty */
+		uint32_t last_used;				/* block_cache_clock when it was last read */
+} block_cache_t;
+
+/* Directory record returned by getdents, one per dentry */
+typedef struct dirent {
+		uint32_t inode_num;				/* inode of the file, 0 for RTC and dir types */
+		uint32_t length;				/* file length in bytes, 0 for RTC and dir types */
+		int32_t file_type;				/* same encoding as dentry_t file_type */
+		int8_t file_name[FILENAME_LEN + 1];	/* null terminated name */
+		int8_t reserved[3];				/* pad the record to 48B */
+} dirent_t;
+
+/* File information returned by stat/fstat */
+typedef struct stat {
+		int32_t file_type;				/* same encoding as dentry_t file_type */
+		uint32_t inode_num;				/* inode of the file, 0 for RTC and dir types */
+		uint32_t length;				/* file length in bytes, 0 for RTC and dir types */
+} stat_t;
+
+/* Dentry cache entry, a dentry found by name in the directory parent */
+typedef struct dcache_entry {
+		uint32_t parent;				/* inode of the directory the dentry is in */
+		uint32_t valid;					/* 0 until the slot is first filled */
+		dentry_t dentry;
+} dcache_entry_t;
+
 /* Boot Block Data Structure */
 typedef struct boot_block {
 		int32_t dir_count;
 		int32_t inode_count;
 		int32_t data_count;
+		uint32_t format;				/* FS_FORMAT_EXTENT, or 0 for block list inodes */
+		uint32_t compression;			/* FS_COMPRESS_LZ4, or 0 for plain datablocks */
 		int8_t reserved[RESERVE2];
 		dentry_t dir_entries[NUM_FILES];
 } boot_block_t;
@@ -61,20 +130,41 @@ boot_block_t* boot_block_ptr;
 uint32_t data_block_start;
 /* FILESYSTEM OPERATIONS helper functions */
 void fs_init(module_t *file_sys_boot);
+void dentry_hash_init();
+void dentry_hash_insert(uint32_t dir_entry_idx);
+int32_t fs_bitmap_init();
+void fs_run_index_init();
 
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
+int32_t read_dentry_in_dir(uint32_t dir, uint32_t index, dentry_t* dentry);
+int32_t dentry_is_dir(const dentry_t* dentry);
+uint32_t dentry_dir_inode(const dentry_t* dentry);
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+int32_t get_inode_length(uint32_t inode);
+uint32_t get_inode_generation(uint32_t inode);
+void inode_exec_retain(uint32_t inode);
+void inode_exec_put(uint32_t inode);
+uint32_t get_data_block_addr(uint32_t inode, uint32_t block);
+void fill_stat(int32_t file_type, uint32_t inode, stat_t* st);
 
 int32_t read_file(int32_t fd, void* buf, int32_t nbytes);
 int32_t write_file(int32_t fd, const void* buf, int32_t nbytes);
 int32_t close_file(int32_t fd);
 int32_t open_file(const uint8_t* filename);
+int32_t lseek_file(int32_t fd, int32_t offset, int32_t whence);
+int32_t seek_position(uint32_t pos, int32_t length, int32_t offset, int32_t whence);
+int32_t pread_file(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+int32_t truncate_data(uint32_t inode, uint32_t length);
+int32_t create_file(const uint8_t* filename);
+int32_t truncate_file(int32_t fd, int32_t length);
 
 int32_t read_dir(int32_t fd, void* buf, int32_t nbytes);
 int32_t write_dir(int32_t fd, const void* buf, int32_t nbytes);
 int32_t close_dir(int32_t fd);
 int32_t open_dir(const uint8_t* filename);
+int32_t read_dirents(int32_t fd, void* buf, int32_t nbytes);
 
 
 #endif // ASM
@@ -0,0 +1,382 @@
+/* frame.c - hands out physical memory in 4KB to 4MB blocks
+ *
+ * Every usable range of the multiboot memory map above 8MB is split into
+ * blocks of 2^order frames, each aligned to its own size, and kept on one
+ * free list per order. Allocating splits a larger block in halves until one
+ * of the wanted order is left; freeing merges a block with its buddy (the
+ * other half of the block they were split from) for as long as the buddy is
+ * free too. Order 10 blocks are 4MB aligned, so they can back 4MB pages.
+ *
+ * Free lists are threaded through the blocks themselves, which the kernel
+ * reaches through the mapping of physical memory at PHYS_MAP_ADDR.
+ *
+ * When there is nothing else to do, frame_zero_idle clears free 4KB frames
+ * ahead of time and keeps them in a pool, so page tables and demand zero
+ * pages don't have to be cleared while someone waits. The pool's frames go
+ * back on the free lists if an allocation would fail otherwise.
+ */
+
+#include "frame.h"
+#include "lib.h"
+
+/* FRAME_FREE | order for the first frame of each free block, 0 for every other frame */
+uint8_t frame_state[PHYS_MAP_FRAMES];
+
+/* mappings of each allocated 4KB frame, for user pages shared copy-on-write */
+uint8_t frame_refs[PHYS_MAP_FRAMES];
+
+/* first free block of each order, 0 if there is none */
+uint32_t free_list[FRAME_MAX_ORDER + 1];
+uint32_t frames_free = 0;
+uint32_t frames_total = 0;
+
+/* zeroed frames ready for frame_alloc_zeroed, kept outside the frames so they stay clear */
+uint32_t zero_pool[ZERO_POOL_FRAMES];
+uint32_t zero_pool_count = 0;
+
+/* the boot modules are usable RAM in the memory map, but have to stay where they are */
+module_t* frame_mods = NULL;
+uint32_t frame_mods_count = 0;
+
+#define FRAME_NUM(addr)		((addr) >> FRAME_SHIFT)
+#define BLOCK_SIZE(order)	(FRAME_SIZE << (order))
+
+/*
+ * void free_list_push(uint32_t addr, uint32_t order)
+ * Inputs: uint32_t addr - physical address of a free block
+ * 		   uint32_t order - its order
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Writes the list links into the block
+ */
+static void free_list_push(uint32_t addr, uint32_t order)
+{
+	free_frame_t* block = PHYS_TO_VIRT(addr);
+
+	block->next = free_list[order];
+	block->prev = 0;
+	if(free_list[order] != 0)
+		((free_frame_t*)PHYS_TO_VIRT(free_list[order]))->prev = addr;
+	free_list[order] = addr;
+	frame_state[FRAME_NUM(addr)] = FRAME_FREE | order;
+}
+
+/*
+ * void free_list_remove(uint32_t addr, uint32_t order)
+ * Inputs: uint32_t addr - physical address of a block on the free list of order
+ * 		   uint32_t order - its order
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+static void free_list_remove(uint32_t addr, uint32_t order)
+{
+	free_frame_t* block = PHYS_TO_VIRT(addr);
+
+	if(block->prev != 0)
+		((free_frame_t*)PHYS_TO_VIRT(block->prev))->next = block->next;
+	else
+		free_list[order] = block->next;
+	if(block->next != 0)
+		((free_frame_t*)PHYS_TO_VIRT(block->next))->prev = block->prev;
+	frame_state[FRAME_NUM(addr)] = 0;
+}
+
+/*
+ * void free_range(uint32_t start, uint32_t end)
+ * Description: frees the frames of [start, end) that aren't part of a boot module,
+ *				in the largest aligned blocks that fit
+ * Inputs: uint32_t start, end - physical range, frame aligned
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+static void free_range(uint32_t start, uint32_t end)
+{
+	uint32_t i, order, mod_start, mod_end;
+
+	for(i = 0; i < frame_mods_count; i++){
+		mod_start = frame_mods[i].mod_start & ~(FRAME_SIZE - 1);
+		mod_end = (frame_mods[i].mod_end + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+		if(mod_start < end && mod_end > start){
+			if(mod_start > start)
+				free_range(start, mod_start);
+			if(mod_end < end)
+				free_range(mod_end, end);
+			return;
+		}
+	}
+
+	while(start < end){
+		for(order = FRAME_MAX_ORDER; order > 0; order--){
+			if((start & (BLOCK_SIZE(order) - 1)) == 0 && BLOCK_SIZE(order) <= end - start)
+				break;
+		}
+		frames_total += 1 << order;
+		frame_free(start, order);
+		start += BLOCK_SIZE(order);
+	}
+}
+
+/*
+ * void frame_init(multiboot_info_t* mbi)
+ * Description: puts the usable RAM above FRAME_FIRST on the free lists. Needs the
+ *				mapping of physical memory set up by initPaging.
+ * Inputs: multiboot_info_t* mbi - boot information, its memory map (or mem_upper if the
+ *				bootloader gave no map) says which RAM is usable
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void frame_init(multiboot_info_t* mbi)
+{
+	memory_map_t* mmap;
+	uint32_t start, end;
+
+	memset(frame_state, 0, sizeof(frame_state));
+	memset(frame_refs, 0, sizeof(frame_refs));
+	memset(free_list, 0, sizeof(free_list));
+	frames_free = 0;
+	frames_total = 0;
+	zero_pool_count = 0;
+
+	if(mbi->flags & MULTIBOOT_INFO_MODS){
+		frame_mods = (module_t*)mbi->mods_addr;
+		frame_mods_count = mbi->mods_count;
+	}
+
+	if(!(mbi->flags & MULTIBOOT_INFO_MEM_MAP)){
+		/* mem_upper is the KB of RAM from 1MB up */
+		if(mbi->flags & MULTIBOOT_INFO_MEMORY && mbi->mem_upper > (FRAME_FIRST >> 10) - 1024)
+			free_range(FRAME_FIRST, ((mbi->mem_upper + 1024) << 10) & ~(FRAME_SIZE - 1));
+		return;
+	}
+
+	for(mmap = (memory_map_t*)mbi->mmap_addr;
+		(uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+		mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))){
+		/* type 1 is available RAM, anything at or past 4GB can't be mapped */
+		if(mmap->type != 1 || mmap->base_addr_high != 0)
+			continue;
+		start = mmap->base_addr_low;
+		if(start >= PHYS_MAP_SIZE)
+			continue;
+		end = (mmap->length_high != 0 || mmap->length_low > PHYS_MAP_SIZE - start)
+			? PHYS_MAP_SIZE : start + mmap->length_low;
+		if(start < FRAME_FIRST)
+			start = FRAME_FIRST;
+		start = (start + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+		end &= ~(FRAME_SIZE - 1);
+		if(start < end)
+			free_range(start, end);
+	}
+}
+
+/*
+ * uint32_t frame_alloc(uint32_t order)
+ * Inputs: uint32_t order - size of the block, 2^order frames
+ * Outputs: None
+ * Return Value: physical address of the block, aligned to its size, 0 if there is no
+ *				 free block that large. The block is not cleared, its reference count is 1.
+ * Side Effects: None
+ */
+uint32_t frame_alloc(uint32_t order)
+{
+	uint32_t addr, split, flags;
+
+	if(order > FRAME_MAX_ORDER)
+		return 0;
+
+	cli_and_save(flags);
+	for(split = order; split <= FRAME_MAX_ORDER && free_list[split] == 0; split++);
+	/* memory is short, the zeroed frames are worth more as free ones */
+	if(split > FRAME_MAX_ORDER && zero_pool_count != 0){
+		while(zero_pool_count != 0)
+			frame_free(zero_pool[--zero_pool_count], 0);
+		for(split = order; split <= FRAME_MAX_ORDER && free_list[split] == 0; split++);
+	}
+	if(split > FRAME_MAX_ORDER){
+		restore_flags(flags);
+		return 0;
+	}
+	addr = free_list[split];
+	free_list_remove(addr, split);
+	/* hand back the upper half of each split until the block is the size asked for */
+	while(split > order){
+		split--;
+		free_list_push(addr + BLOCK_SIZE(split), split);
+	}
+	frames_free -= 1 << order;
+	frame_refs[FRAME_NUM(addr)] = 1;
+	restore_flags(flags);
+
+	return addr;
+}
+
+/*
+ * void frame_free(uint32_t addr, uint32_t order)
+ * Inputs: uint32_t addr - block from frame_alloc
+ * 		   uint32_t order - the order it was allocated with
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Merges the block with its free buddies
+ */
+void frame_free(uint32_t addr, uint32_t order)
+{
+	uint32_t buddy, flags;
+
+	if(addr == 0)
+		return;
+
+	cli_and_save(flags);
+	frames_free += 1 << order;
+	while(order < FRAME_MAX_ORDER){
+		buddy = addr ^ BLOCK_SIZE(order);
+		if(buddy >= PHYS_MAP_SIZE || frame_state[FRAME_NUM(buddy)] != (FRAME_FREE | order))
+			break;
+		free_list_remove(buddy, order);
+		addr &= ~BLOCK_SIZE(order);
+		order++;
+	}
+	free_list_push(addr, order);
+	restore_flags(flags);
+}
+
+/*
+ * uint32_t frame_alloc_zeroed()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: physical address of a cleared 4KB frame, from the pool when it has one,
+ *				 0 if there is no free frame. Its reference count is 1.
+ * Side Effects: None
+ */
+uint32_t frame_alloc_zeroed()
+{
+	uint32_t addr, flags;
+
+	cli_and_save(flags);
+	if(zero_pool_count != 0){
+		addr = zero_pool[--zero_pool_count];
+		restore_flags(flags);
+		return addr;
+	}
+	restore_flags(flags);
+
+	if((addr = frame_alloc(0)) != 0)
+		memset(PHYS_TO_VIRT(addr), 0, FRAME_SIZE);
+	return addr;
+}
+
+/*
+ * uint32_t frame_zero_idle()
+ * Description: clears one free frame for the zeroed pool. Called from the loops that
+ *				wait for input or the rtc, the clearing happens with interrupts on.
+ * Inputs: None
+ * Outputs: None
+ * Return Value: 1 if a frame was cleared, 0 if the pool is full or memory is short
+ * Side Effects: None
+ */
+uint32_t frame_zero_idle()
+{
+	uint32_t addr, flags;
+
+	/* leave the last free frames to allocations that need them */
+	if(zero_pool_count >= ZERO_POOL_FRAMES || frames_free <= ZERO_POOL_FRAMES)
+		return 0;
+	if((addr = frame_alloc(0)) == 0)
+		return 0;
+	memset(PHYS_TO_VIRT(addr), 0, FRAME_SIZE);
+
+	cli_and_save(flags);
+	if(zero_pool_count < ZERO_POOL_FRAMES){
+		zero_pool[zero_pool_count++] = addr;
+		addr = 0;
+	}
+	restore_flags(flags);
+	/* something else filled the pool meanwhile */
+	frame_free(addr, 0);
+	return 1;
+}
+
+/*
+ * uint32_t frame_zeroed_count()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: number of zeroed frames in the pool
+ * Side Effects: None
+ */
+uint32_t frame_zeroed_count()
+{
+	return zero_pool_count;
+}
+
+/*
+ * void frame_share(uint32_t addr)
+ * Description: counts one more mapping of a 4KB frame
+ * Inputs: uint32_t addr - frame from frame_alloc(0)
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void frame_share(uint32_t addr)
+{
+	uint32_t flags;
+
+	cli_and_save(flags);
+	frame_refs[FRAME_NUM(addr)]++;
+	restore_flags(flags);
+}
+
+/*
+ * void frame_put(uint32_t addr)
+ * Description: drops one mapping of a 4KB frame, and frees it with the last one
+ * Inputs: uint32_t addr - frame from frame_alloc(0)
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void frame_put(uint32_t addr)
+{
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(--frame_refs[FRAME_NUM(addr)] == 0)
+		frame_free(addr, 0);
+	restore_flags(flags);
+}
+
+/*
+ * uint32_t frame_refcount(uint32_t addr)
+ * Inputs: uint32_t addr - frame from frame_alloc(0)
+ * Outputs: None
+ * Return Value: number of mappings of the frame
+ * Side Effects: None
+ */
+uint32_t frame_refcount(uint32_t addr)
+{
+	return frame_refs[FRAME_NUM(addr)];
+}
+
+/*
+ * uint32_t frame_free_count()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: number of free 4KB frames
+ * Side Effects: None
+ */
+uint32_t frame_free_count()
+{
+	return frames_free;
+}
+
+/*
+ * uint32_t frame_total_count()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: number of 4KB frames frame_init found usable
+ * Side Effects: None
+ */
+uint32_t frame_total_count()
+{
+	return frames_total;
+}
@@ -0,0 +1,47 @@
+/* frame.h - Buddy allocator for physical memory frames */
+
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define FRAME_SIZE		0x1000		// smallest block handed out (order 0)
+#define FRAME_SHIFT		12
+#define FRAME_MAX_ORDER	10			// largest block, 1024 frames = one 4MB page
+#define FRAME_ORDER_8KB	1			// PCB + kernel stack
+#define FRAME_ORDER_4MB	10			// one 4MB page
+#define FRAME_FIRST		0x800000	// memory below 8MB is the kernel's and the boot modules'
+#define PHYS_MAP_ADDR	0xC0000000	// physical memory is mapped for the kernel from here
+#define PHYS_MAP_PDE	768			// PHYS_MAP_ADDR / 4MB
+#define PHYS_MAP_SIZE	0x40000000	// 1GB, frames above this are not used
+#define PHYS_MAP_FRAMES	(PHYS_MAP_SIZE >> FRAME_SHIFT)
+#define FRAME_FREE		0x80		// frame_state of the first frame of a free block, with its order
+#define ZERO_POOL_FRAMES	256		// zeroed frames the idle loop keeps ready (1MB)
+
+/* kernel virtual address of a frame, and back */
+#define PHYS_TO_VIRT(addr)	((void*)((uint32_t)(addr) + PHYS_MAP_ADDR))
+#define VIRT_TO_PHYS(ptr)	((uint32_t)(ptr) - PHYS_MAP_ADDR)
+#ifndef ASM
+
+/* Links of a free block, kept in the block's first bytes */
+typedef struct free_frame {
+	uint32_t next;					/* physical address of the next free block of the order, 0 at the end */
+	uint32_t prev;					/* physical address of the previous one, 0 at the head */
+} free_frame_t;
+
+void frame_init(multiboot_info_t* mbi);
+uint32_t frame_alloc(uint32_t order);
+void frame_free(uint32_t addr, uint32_t order);
+uint32_t frame_alloc_zeroed();
+uint32_t frame_zero_idle();
+uint32_t frame_zeroed_count();
+void frame_share(uint32_t addr);
+void frame_put(uint32_t addr);
+uint32_t frame_refcount(uint32_t addr);
+uint32_t frame_free_count();
+uint32_t frame_total_count();
+
+#endif /* ASM */
+
+#endif /* _FRAME_H */
@@ -5,6 +5,7 @@
 #include "rtc.h"
 #include "i8259.h"
 #include "syscall.h"
+#include "paging.h"
 
 void idt_0();
 void idt_1();
@@ -20,7 +21,7 @@ void idt_10();
 void idt_11();
 void idt_12();
 void idt_13();
-void idt_14();
+void idt_14(uint32_t error);
 void idt_15();
 void idt_16();
 void idt_17();
@@ -43,7 +44,7 @@ idt_init ()
     for (i = 0; i < NUM_VEC; i++) {
         idt[i].seg_selector = KERNEL_CS;
         idt[i].reserved4 = 0;
-        if (i >= 0 && i < 32 && i != 3) // fault/trap
+        if (i >= 0 && i < 32 && i != 3 && i != 14) // fault/trap, page faults keep cr2 safe with interrupts off
             idt[i].reserved3 = 1;
         else                            // interrupt
             idt[i].reserved3 = 0;
@@ -73,7 +74,7 @@ idt_init ()
     SET_IDT_ENTRY (idt[11], idt_11);
     SET_IDT_ENTRY (idt[12], idt_12);
     SET_IDT_ENTRY (idt[13], idt_13);
-    SET_IDT_ENTRY (idt[14], idt_14);
+    SET_IDT_ENTRY (idt[14], pf_handler);
     SET_IDT_ENTRY (idt[15], idt_15);
     SET_IDT_ENTRY (idt[16], idt_16);
     SET_IDT_ENTRY (idt[17], idt_17);
@@ -209,7 +210,17 @@ void idt_13() {
 	exception_status = EXCEPTION_FLAG;
     halt((uint8_t)EXCEPTION_FLAG);
 }
-void idt_14() {
+/*
+ * idt_14 (uint32_t error)
+ * Description: Page faults on pages of the process's regions map the page and return to
+ *				retry the access, anything else kills the process. Called from pf_handler.
+ */
+void idt_14(uint32_t error) {
+    uint32_t addr;
+
+    asm volatile ("movl %%cr2, %0" : "=r"(addr));
+    if (handle_page_fault(addr, error) == 0)
+        return;
     printf ("Page Fault \n");
     exception_status = EXCEPTION_FLAG;
     halt((uint8_t)EXCEPTION_FLAG);
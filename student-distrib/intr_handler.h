@@ -10,6 +10,7 @@ extern void kb_handler();
 extern void rtc_handler();
 extern void syscall_handler();
 extern void pit_handler();
+extern void pf_handler();
 
 #endif
 #endif
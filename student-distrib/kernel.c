@@ -14,6 +14,9 @@
 #include "filesys.h"
 #include "syscall.h"
 #include "scheduling.h"
+#include "pagepool.h"
+#include "frame.h"
+#include "kmalloc.h"
 #define RUN_TESTS
 
 /* Macros. */
@@ -149,9 +152,15 @@ void entry(unsigned long magic, unsigned long addr) {
     i8259_init();
     /* init filesys */
     fs_init((module_t*)mbi->mods_addr);
+    /* init the kernel page pool (tmpfs) */
+    page_pool_init();
     //init_filesys((boot_block*)fs_loc);
     /* init the paging */
     initPaging();
+    /* hand the RAM above 8MB to the frame allocator, it needs physical memory mapped */
+    frame_init(mbi);
+    /* size classes of the kernel heap, its slabs come from the frame allocator */
+    kmalloc_init();
     /* init the Keyboard */
     keyboard_init();
     /* init rtc */
@@ -194,7 +203,10 @@ void entry(unsigned long magic, unsigned long addr) {
     //execute((uint8_t*)"shell");
     
     switch_terminal(0);
-    /* Spin (nicely, so we don't chew up cycles) */
-    asm volatile (".1: hlt; jmp .1;");
+    /* Spin (nicely, so we don't chew up cycles), after filling the zeroed frame pool */
+    while (1) {
+        if (!frame_zero_idle())
+            asm volatile ("hlt");
+    }
 }
 
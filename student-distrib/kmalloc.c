@@ -0,0 +1,187 @@
+/* kmalloc.c - kernel heap for objects that come and go
+ *
+ * Requests up to KMALLOC_MAX_SIZE bytes are served from the cache of the
+ * smallest power of two size class that fits. A cache's slabs are 4KB frames
+ * from frame_alloc, reached through the mapping of physical memory, with a
+ * slab_t at the start and the objects after it. Each slab keeps its own free
+ * objects on a list threaded through them, and the cache keeps the slabs that
+ * have any free on its partial list, so kmalloc and kfree don't search.
+ * A slab whose objects are all free is given back, unless it is the only
+ * slab of its cache with room left. Larger requests get frames of their own,
+ * with a slab_t in front that marks them as such.
+ */
+
+#include "kmalloc.h"
+#include "frame.h"
+#include "lib.h"
+
+kmem_cache_t kmalloc_caches[KMALLOC_CLASSES];
+
+/*
+ * void partial_push(kmem_cache_t* cache, slab_t* slab)
+ * Inputs: kmem_cache_t* cache - cache of the slab
+ * 		   slab_t* slab - slab that has free objects again
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+static void partial_push(kmem_cache_t* cache, slab_t* slab)
+{
+	slab->next = cache->partial;
+	slab->prev = NULL;
+	if(cache->partial != NULL)
+		cache->partial->prev = slab;
+	cache->partial = slab;
+}
+
+/*
+ * void partial_remove(kmem_cache_t* cache, slab_t* slab)
+ * Inputs: kmem_cache_t* cache - cache of the slab
+ * 		   slab_t* slab - slab on its partial list
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+static void partial_remove(kmem_cache_t* cache, slab_t* slab)
+{
+	if(slab->prev != NULL)
+		slab->prev->next = slab->next;
+	else
+		cache->partial = slab->next;
+	if(slab->next != NULL)
+		slab->next->prev = slab->prev;
+}
+
+/*
+ * slab_t* slab_grow(kmem_cache_t* cache)
+ * Inputs: kmem_cache_t* cache - cache that ran out of free objects
+ * Outputs: None
+ * Return Value: a new slab with all its objects free, on the partial list,
+ *				 NULL if there is no free frame
+ * Side Effects: None
+ */
+static slab_t* slab_grow(kmem_cache_t* cache)
+{
+	uint32_t frame, i;
+	uint8_t* object;
+	slab_t* slab;
+
+	if((frame = frame_alloc(0)) == 0)
+		return NULL;
+	slab = PHYS_TO_VIRT(frame);
+	slab->cache = cache;
+	slab->in_use = 0;
+	slab->free = NULL;
+	/* thread the free list from the back so objects go out in address order */
+	for(i = cache->per_slab; i > 0; i--){
+		object = (uint8_t*)slab + SLAB_HEADER + (i - 1) * cache->size;
+		*(void**)object = slab->free;
+		slab->free = object;
+	}
+	partial_push(cache, slab);
+	cache->slabs++;
+	return slab;
+}
+
+/*
+ * void kmalloc_init()
+ * Description: sets up the size classes. Needs frame_init to have run before the
+ *				first kmalloc.
+ * Inputs: None
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void kmalloc_init()
+{
+	int i;
+
+	memset(kmalloc_caches, 0, sizeof(kmalloc_caches));
+	for(i = 0; i < KMALLOC_CLASSES; i++){
+		kmalloc_caches[i].size = 1 << (KMALLOC_MIN_SHIFT + i);
+		kmalloc_caches[i].per_slab = (SLAB_SIZE - SLAB_HEADER) >> (KMALLOC_MIN_SHIFT + i);
+	}
+}
+
+/*
+ * void* kmalloc(uint32_t size)
+ * Inputs: uint32_t size - bytes wanted
+ * Outputs: None
+ * Return Value: 16 byte aligned memory, not cleared, NULL if size is 0 or there is
+ *				 no memory left
+ * Side Effects: None
+ */
+void* kmalloc(uint32_t size)
+{
+	kmem_cache_t* cache;
+	slab_t* slab;
+	void* object;
+	uint32_t i, order, frame, flags;
+
+	if(size == 0)
+		return NULL;
+
+	if(size > KMALLOC_MAX_SIZE){
+		for(order = 0; order <= FRAME_MAX_ORDER && (FRAME_SIZE << order) - SLAB_HEADER < size; order++);
+		if(order > FRAME_MAX_ORDER || (frame = frame_alloc(order)) == 0)
+			return NULL;
+		slab = PHYS_TO_VIRT(frame);
+		slab->cache = NULL;
+		slab->in_use = order;
+		return (uint8_t*)slab + SLAB_HEADER;
+	}
+
+	for(i = 0; kmalloc_caches[i].size < size; i++);
+	cache = &kmalloc_caches[i];
+
+	cli_and_save(flags);
+	if((slab = cache->partial) == NULL && (slab = slab_grow(cache)) == NULL){
+		restore_flags(flags);
+		return NULL;
+	}
+	object = slab->free;
+	slab->free = *(void**)object;
+	slab->in_use++;
+	if(slab->free == NULL)
+		partial_remove(cache, slab);
+	cache->in_use++;
+	cache->allocs++;
+	restore_flags(flags);
+
+	return object;
+}
+
+/*
+ * void kfree(void* ptr)
+ * Inputs: void* ptr - memory from kmalloc, or NULL
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Gives the slab back to the frame allocator if it is left empty
+ */
+void kfree(void* ptr)
+{
+	slab_t* slab = (slab_t*)((uint32_t)ptr & ~(SLAB_SIZE - 1));
+	kmem_cache_t* cache;
+	uint32_t flags;
+
+	if(ptr == NULL)
+		return;
+	if((cache = slab->cache) == NULL){
+		frame_free(VIRT_TO_PHYS(slab), slab->in_use);
+		return;
+	}
+
+	cli_and_save(flags);
+	if(slab->free == NULL)
+		partial_push(cache, slab);
+	*(void**)ptr = slab->free;
+	slab->free = ptr;
+	slab->in_use--;
+	cache->in_use--;
+	if(slab->in_use == 0 && (slab->next != NULL || slab->prev != NULL)){
+		partial_remove(cache, slab);
+		cache->slabs--;
+		frame_free(VIRT_TO_PHYS(slab), 0);
+	}
+	restore_flags(flags);
+}
@@ -0,0 +1,42 @@
+/* kmalloc.h - Kernel heap, size class slab caches over the frame allocator */
+
+#ifndef _KMALLOC_H
+#define _KMALLOC_H
+
+#include "types.h"
+
+#define KMALLOC_MIN_SHIFT	4			// smallest size class, 16 bytes
+#define KMALLOC_CLASSES		7			// 16, 32, ... 1024 bytes
+#define KMALLOC_MAX_SIZE	(1 << (KMALLOC_MIN_SHIFT + KMALLOC_CLASSES - 1))
+#define SLAB_SIZE			0x1000		// a slab is one 4KB frame
+#define SLAB_HEADER			32			// slab_t rounded up, objects after it stay 16 byte aligned
+#ifndef ASM
+
+/* Start of every slab, and of every allocation too big for a size class */
+typedef struct slab {
+	struct kmem_cache* cache;		/* cache the slab belongs to, NULL for a large allocation */
+	struct slab* next;				/* next slab with free objects in the cache */
+	struct slab* prev;				/* previous one, NULL at the head */
+	void* free;						/* first free object, each one starts with a pointer to the next */
+	uint32_t in_use;				/* objects handed out, the frame order for a large allocation */
+} slab_t;
+
+/* One size class */
+typedef struct kmem_cache {
+	uint32_t size;					/* bytes per object */
+	uint32_t per_slab;				/* objects that fit in a slab after its header */
+	slab_t* partial;				/* slabs with free objects */
+	uint32_t slabs;					/* slabs the cache holds */
+	uint32_t in_use;				/* objects handed out now */
+	uint32_t allocs;				/* objects ever handed out */
+} kmem_cache_t;
+
+extern kmem_cache_t kmalloc_caches[KMALLOC_CLASSES];
+
+void kmalloc_init();
+void* kmalloc(uint32_t size);
+void kfree(void* ptr);
+
+#endif /* ASM */
+
+#endif /* _KMALLOC_H */
@@ -0,0 +1,225 @@
+/* lz4.c - decodes LZ4 block format data (no frame header)
+ *
+ * A block is a list of sequences. Each starts with a token byte whose high
+ * nibble is the literal length and low nibble the match length minus 4, a
+ * nibble of 15 continuing in extra bytes that are added up until one is
+ * below 255. The literals follow, then a 2-byte little endian offset back
+ * into the output the match is copied from. The last sequence has literals
+ * only.
+ *
+ * The compressor is the greedy one createfs uses: a hash table remembers the
+ * last position each 4-byte sequence was seen at, and a repeat becomes a
+ * match as long as it goes. It gives up as soon as the output would not fit,
+ * so callers can ask for a size they consider worth storing.
+ */
+
+#include "lz4.h"
+#include "lib.h"
+
+/*
+ * int32_t lz4_read_length(const uint8_t** src, const uint8_t* src_end, uint32_t length)
+ * Inputs: const uint8_t** src - position in the input, moved past the extra bytes
+ *		   const uint8_t* src_end - end of the input
+ *		   uint32_t length - the 4-bit length from the token
+ * Outputs: None
+ * Return Value: the full length, -1 if the input ends inside it
+ * Side Effects: None
+ */
+static int32_t lz4_read_length(const uint8_t** src, const uint8_t* src_end, uint32_t length)
+{
+	uint8_t extra;
+
+	if(length != LZ4_RUN_MASK)
+		return length;
+	do {
+		if(*src >= src_end)
+			return -1;
+		extra = *(*src)++;
+		length += extra;
+	} while(extra == 255);
+	return length;
+}
+
+/* last position + 1 each hash of 4 bytes was seen at, 0 if not yet in this block */
+static uint16_t lz4_table[1 << LZ4_HASH_BITS];
+
+/*
+ * uint8_t* lz4_put_length(uint8_t* out, uint8_t* out_end, uint32_t length)
+ * Inputs: uint8_t* out - position in the output
+ *		   uint8_t* out_end - end of the output
+ *		   uint32_t length - what is left of a length after the 4-bit nibble
+ * Outputs: None
+ * Return Value: position after the extra bytes, NULL if they don't fit
+ * Side Effects: None
+ */
+static uint8_t* lz4_put_length(uint8_t* out, uint8_t* out_end, uint32_t length)
+{
+	for(; length >= 255; length -= 255){
+		if(out >= out_end)
+			return NULL;
+		*out++ = 255;
+	}
+	if(out >= out_end)
+		return NULL;
+	*out++ = length;
+	return out;
+}
+
+/*
+ * uint8_t* lz4_put_sequence(uint8_t* out, uint8_t* out_end, const uint8_t* literals,
+ *							 uint32_t lit_len, uint32_t offset, uint32_t match_len)
+ * Inputs: uint8_t* out - position in the output
+ *		   uint8_t* out_end - end of the output
+ *		   const uint8_t* literals - bytes copied as they are
+ *		   uint32_t lit_len - number of literals
+ *		   uint32_t offset - distance back to the match
+ *		   uint32_t match_len - length of the match, 0 for the last sequence of a block
+ * Outputs: None
+ * Return Value: position after the sequence, NULL if it doesn't fit
+ * Side Effects: None
+ */
+static uint8_t* lz4_put_sequence(uint8_t* out, uint8_t* out_end, const uint8_t* literals,
+								 uint32_t lit_len, uint32_t offset, uint32_t match_len)
+{
+	uint8_t* token = out++;
+
+	if(token >= out_end)
+		return NULL;
+	*token = (lit_len < LZ4_RUN_MASK ? lit_len : LZ4_RUN_MASK) << 4;
+	if(lit_len >= LZ4_RUN_MASK && (out = lz4_put_length(out, out_end, lit_len - LZ4_RUN_MASK)) == NULL)
+		return NULL;
+	if(lit_len > out_end - out)
+		return NULL;
+	memcpy(out, literals, lit_len);
+	out += lit_len;
+	if(match_len == 0)
+		return out;
+
+	if(out_end - out < 2)
+		return NULL;
+	*out++ = offset & 0xFF;
+	*out++ = offset >> 8;
+	match_len -= LZ4_MIN_MATCH;
+	*token |= match_len < LZ4_RUN_MASK ? match_len : LZ4_RUN_MASK;
+	if(match_len >= LZ4_RUN_MASK)
+		return lz4_put_length(out, out_end, match_len - LZ4_RUN_MASK);
+	return out;
+}
+
+/*
+ * uint32_t lz4_read32(const uint8_t* p)
+ * Inputs: const uint8_t* p - any address
+ * Outputs: None
+ * Return Value: the 4 bytes at p
+ * Side Effects: None
+ */
+static uint32_t lz4_read32(const uint8_t* p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/*
+ * int32_t lz4_compress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len)
+ * Inputs: const uint8_t* src - data to compress, at most LZ4_MAX_INPUT bytes
+ *		   uint32_t src_len - size of the data
+ *		   uint8_t* dst - buffer for the compressed block
+ *		   uint32_t dst_len - size of dst, the most the caller wants the block to take
+ * Outputs: None
+ * Return Value: size of the block, -1 if it doesn't fit in dst or src is too long
+ * Side Effects: Uses one static table, callers keep interrupts off around it
+ */
+int32_t lz4_compress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len)
+{
+	uint8_t* out = dst;
+	uint8_t* out_end = dst + dst_len;
+	uint32_t ip = 0, anchor = 0, ref, match_len, hash;
+
+	if(src_len > LZ4_MAX_INPUT)
+		return -1;
+	memset(lz4_table, 0, sizeof(lz4_table));
+	while(src_len >= LZ4_MFLIMIT && ip <= src_len - LZ4_MFLIMIT){
+		hash = (lz4_read32(src + ip) * 2654435761U) >> (32 - LZ4_HASH_BITS);
+		ref = lz4_table[hash];
+		lz4_table[hash] = ip + 1;
+		if(ref == 0 || lz4_read32(src + ref - 1) != lz4_read32(src + ip)){
+			ip++;
+			continue;
+		}
+		ref--;
+		for(match_len = LZ4_MIN_MATCH;
+			ip + match_len < src_len - LZ4_LAST_LITERALS && src[ref + match_len] == src[ip + match_len];
+			match_len++);
+		if((out = lz4_put_sequence(out, out_end, src + anchor, ip - anchor, ip - ref, match_len)) == NULL)
+			return -1;
+		ip += match_len;
+		anchor = ip;
+	}
+	if((out = lz4_put_sequence(out, out_end, src + anchor, src_len - anchor, 0, 0)) == NULL)
+		return -1;
+	return out - dst;
+}
+
+/*
+ * int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len)
+ * Inputs: const uint8_t* src - compressed block
+ *		   uint32_t src_len - size of the compressed block
+ *		   uint8_t* dst - buffer for the decompressed data
+ *		   uint32_t dst_len - size of dst
+ * Outputs: None
+ * Return Value: bytes written to dst, -1 if the block is corrupt or doesn't fit in dst
+ * Side Effects: None
+ */
+int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len)
+{
+	const uint8_t* src_end = src + src_len;
+	uint8_t* out = dst;
+	uint8_t* dst_end = dst + dst_len;
+	const uint8_t* match;
+	int32_t literals, match_len;
+	uint32_t offset;
+	uint8_t token;
+
+	while(src < src_end){
+		token = *src++;
+
+		/* literals are copied straight from the input */
+		if((literals = lz4_read_length(&src, src_end, token >> 4)) == -1)
+			return -1;
+		if(literals > src_end - src || literals > dst_end - out)
+			return -1;
+		memcpy(out, src, literals);
+		out += literals;
+		src += literals;
+
+		/* the last sequence stops after its literals */
+		if(src == src_end)
+			break;
+
+		if(src_end - src < 2)
+			return -1;
+		offset = src[0] | (src[1] << 8);
+		src += 2;
+		if(offset == 0 || offset > out - dst)
+			return -1;
+		if((match_len = lz4_read_length(&src, src_end, token & LZ4_RUN_MASK)) == -1)
+			return -1;
+		match_len += LZ4_MIN_MATCH;
+		if(match_len > dst_end - out)
+			return -1;
+
+		/* a match can overlap the bytes it produces, so it is copied forward a byte at a time */
+		match = out - offset;
+		if(offset >= match_len) {
+			memcpy(out, match, match_len);
+			out += match_len;
+		} else {
+			while(match_len-- > 0)
+				*out++ = *match++;
+		}
+	}
+
+	return out - dst;
+}
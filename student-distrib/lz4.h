@@ -0,0 +1,21 @@
+/* lz4.h - LZ4 block coder, for compressed filesystem images and compressed swap */
+
+#ifndef _LZ4_H
+#define _LZ4_H
+
+#include "types.h"
+
+#define LZ4_MIN_MATCH		4		// match lengths are stored minus this
+#define LZ4_RUN_MASK		0x0F	// a 4-bit length of 15 continues in extra bytes
+#define LZ4_LAST_LITERALS	5		// a block ends in at least this many literals
+#define LZ4_MFLIMIT			12		// and its last match starts at least this far from the end
+#define LZ4_HASH_BITS		12		// entries in the compressor's table of positions, 2^12
+#define LZ4_MAX_INPUT		0xFFFF	// the table keeps 16-bit positions
+#ifndef ASM
+
+int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len);
+int32_t lz4_compress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len);
+
+#endif /* ASM */
+
+#endif /* _LZ4_H */
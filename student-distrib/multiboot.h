@@ -10,6 +10,11 @@
 #define MULTIBOOT_HEADER_MAGIC          0x1BADB002
 #define MULTIBOOT_BOOTLOADER_MAGIC      0x2BADB002
 
+/* Bits of multiboot_info_t flags saying which fields are valid */
+#define MULTIBOOT_INFO_MEMORY           0x00000001  /* mem_lower, mem_upper */
+#define MULTIBOOT_INFO_MODS             0x00000008  /* mods_count, mods_addr */
+#define MULTIBOOT_INFO_MEM_MAP          0x00000040  /* mmap_length, mmap_addr */
+
 #ifndef ASM
 
 /* Types */
@@ -0,0 +1,89 @@
+/* pagepool.c - hands out 4KB pages of kernel memory
+ *
+ * The pages live in the kernel's 4MB page, so they are mapped and usable by
+ * the kernel as they are. Free pages are kept on a list threaded through
+ * their first word.
+ */
+
+#include "pagepool.h"
+#include "lib.h"
+
+uint8_t pool_pages[POOL_PAGES][POOL_PAGE_SIZE] __attribute__((aligned(POOL_PAGE_SIZE)));
+
+/* first free page, each free page starts with a pointer to the next one */
+void* pool_free_list = NULL;
+uint32_t pool_free_pages = 0;
+
+/*
+ * void page_pool_init()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Puts every page of the pool on the free list
+ */
+void page_pool_init()
+{
+	int i;
+
+	pool_free_list = NULL;
+	pool_free_pages = 0;
+	for(i = POOL_PAGES - 1; i >= 0; i--)
+		page_free(pool_pages[i]);
+}
+
+/*
+ * void* page_alloc()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: a zeroed 4KB page, NULL if the pool is empty
+ * Side Effects: None
+ */
+void* page_alloc()
+{
+	void* page;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	page = pool_free_list;
+	if(page != NULL){
+		pool_free_list = *(void**)page;
+		pool_free_pages--;
+	}
+	restore_flags(flags);
+
+	if(page != NULL)
+		memset(page, 0, POOL_PAGE_SIZE);
+	return page;
+}
+
+/*
+ * void page_free(void* page)
+ * Inputs: void* page - page from page_alloc
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void page_free(void* page)
+{
+	uint32_t flags;
+
+	if(page == NULL)
+		return;
+	cli_and_save(flags);
+	*(void**)page = pool_free_list;
+	pool_free_list = page;
+	pool_free_pages++;
+	restore_flags(flags);
+}
+
+/*
+ * uint32_t page_pool_free_count()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: number of pages left in the pool
+ * Side Effects: None
+ */
+uint32_t page_pool_free_count()
+{
+	return pool_free_pages;
+}
@@ -0,0 +1,19 @@
+/* pagepool.h - Pool of 4KB kernel pages for kernel objects that come and go */
+
+#ifndef _PAGEPOOL_H
+#define _PAGEPOOL_H
+
+#include "types.h"
+
+#define POOL_PAGES		256			// pages in the pool (1MB)
+#define POOL_PAGE_SIZE	0x1000
+#ifndef ASM
+
+void page_pool_init();
+void* page_alloc();
+void page_free(void* page);
+uint32_t page_pool_free_count();
+
+#endif /* ASM */
+
+#endif /* _PAGEPOOL_H */
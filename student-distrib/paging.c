@@ -4,6 +4,9 @@
 #include "types.h"
 #include "lib.h"
 #include "scheduling.h"
+#include "frame.h"
+#include "text.h"
+#include "swap.h"
 
 /* Set up page directory for 4 GB */
 uint32_t page_directory[PAGES_NUM] __attribute__((aligned(ENTRY_SIZE)));
@@ -35,16 +38,22 @@ void initPaging(){
 	 * set following entry bits:
 	 * 	G = 1
 	 * 	PS = 1
-	 *	PCD = 1
 	 *	R/W = 1
 	 *	P = 1
+	 * Every page directory has this entry, so it is global and survives cr3 reloads.
 	 */
-	page_directory[1] = ((unsigned int)KERNEL_ADDR) | (ENTRY_4MB | P | RW);
+	page_directory[1] = ((unsigned int)KERNEL_ADDR) | (G | ENTRY_4MB | P | RW);
+
+	/* map physical memory from PHYS_MAP_ADDR with supervisor 4MB pages, so the kernel
+	 * can reach every frame frame_alloc hands out */
+	for(i = 0; i < PHYS_MAP_SIZE / KERNEL_ADDR; i++){
+		page_directory[PHYS_MAP_PDE + i] = (i * KERNEL_ADDR) | (G | ENTRY_4MB | P | RW);
+	}
 	
 	/* initialize page table to not present for now */
 	for(i = 0; i < PAGES_NUM; i++){
 		if (i >= VIDMEM && i <= VIDMEM + 3)
-			page_table[i] = (i * ENTRY_SIZE) | (P | RW | US); /* set U/S to 0 (supervisor), R/W and present to 1 */
+			page_table[i] = (i * ENTRY_SIZE) | (G | P | RW | US); /* video memory and the terminal buffers, same in every process */
 		else 
 			page_table[i] = (i * ENTRY_SIZE) | (RW);	/* set present and U/S to 0 (supervisor), RW to 1 */
 	}
@@ -69,23 +78,69 @@ void initPaging(){
 
 
 /*
- * void set_process_page(int32_t addr)
- * Description: sets process page (4MB each) in page directory then flushes tlb.
- * Inputs: int32_t addr - physical addr of program
+ * void build_page_directory(uint32_t dir_addr, uint32_t user_table, uint32_t mmap_table)
+ * Description: fills in a process's page directory: the kernel's entries as they are in
+ *				page_directory, so the low page table, the kernel page and the mapping of
+ *				physical memory are shared, then its user page table and its mmap window.
+ *				The vidmap entry stays unmapped until the process calls vidmap.
+ * Inputs: uint32_t dir_addr - physical addr of the frame to fill in
+ * 		   uint32_t user_table - physical addr of the page table of its program and stack
+ * 		   uint32_t mmap_table - physical addr of its mmap window page table
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void build_page_directory(uint32_t dir_addr, uint32_t user_table, uint32_t mmap_table)
+{
+	uint32_t* dir = PHYS_TO_VIRT(dir_addr);
+
+	memcpy(dir, page_directory, sizeof(page_directory));
+	dir[USER_PDE] = user_table | (US | RW | P);
+	dir[VIDMAP_PDE] = RW;
+	dir[MMAP_PDE] = mmap_table | (US | RW | P);
+}
+
+
+/*
+ * void switch_page_directory(uint32_t dir)
+ * Description: makes dir the current address space. CR3 is only reloaded, and the tlb
+ *				flushed, when dir isn't already the current page directory.
+ * Inputs: uint32_t dir - physical addr of a process's page directory, 0 for the kernel's
  * Outputs: None
  * Return Value: None
  * Side Effects: None
  */
-void set_process_page(int32_t addr)
+void switch_page_directory(uint32_t dir)
 {
-  	page_directory[32]= addr | 0x87;	// ENTRY_4MB(0x80) | P (1) | RW(2) | US(4)
+	uint32_t cr3;
+
+	if(dir == 0)
+		dir = (uint32_t)page_directory;
+	asm volatile ("movl %%cr3, %0" : "=r"(cr3));
+	if(cr3 != dir)
+		asm volatile ("movl %0, %%cr3" : : "r"(dir) : "memory");
+}
 
-  	flush_tlb();
+
+/*
+ * void invalidate_page(uint32_t virt_addr)
+ * Description: drops the tlb entry of one page after its mapping changed, instead of
+ *				flushing every entry the way a CR3 reload does
+ * Inputs: uint32_t virt_addr - any address in the page
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void invalidate_page(uint32_t virt_addr)
+{
+	asm volatile ("invlpg (%0)" : : "r"(virt_addr) : "memory");
 }
 
 
 /* 
  * void flush_tlb()
+ * Description: flushes the tlb entries of the current address space. Global kernel
+ *				entries stay, so kernel mappings must not change after initPaging.
  * Inputs: None
  * Outputs: None
  * Return Value: None
@@ -105,27 +160,396 @@ void flush_tlb()
 
 
 /* 
- * void map2user(uint32_t virt_addr, uint32_t phys_addr, uint32_t dest_page, uint8_t type) 
- * Description: This function maps text-mode vid mem to user space. Either to user program pagetable or vidmem pagetable.
- * Inputs:  uint32_t virt_addr - virtual addr, used to obtain the page directory entry for user program/vidmem pagetable
- *  		uint32_t phys_addr - physical addr to map vid mem 
- * 			uint32_t dest_page - destination page, in user program pagetable
- * 			uint8_t type - determine if mape to user program pagetable or vidmem pagetable
+ * void map2user(uint32_t phys_addr, uint32_t dest_page, uint8_t type) 
+ * Description: This function maps text-mode vid mem to user space through the vidmem pagetable,
+ *				which every process that called vidmap shares.
+ * Inputs:  uint32_t phys_addr - physical addr to map vid mem 
+ * 			uint32_t dest_page - destination page, in the vidmem pagetable
+ * 			uint8_t type - 1 to also map the vidmem pagetable into the current process's page
+ *				directory (vidmap), 0 to only retarget the page (scheduling)
  * Outputs: None
  * Return Value: None
- * Side Effects: flush tlb
+ * Side Effects: invalidates the tlb entry of the page
  */
 void map2user(uint32_t phys_addr, uint32_t dest_page, uint8_t type) 
 {
+	uint32_t cr3;
+	uint32_t* dir;
 
-    uint32_t pagedir_entry = 33;
+	vidmem_pagetable[dest_page] = phys_addr | (US | RW | P); 
 	if (type == 1) {
+		asm volatile ("movl %%cr3, %0" : "=r"(cr3));
+		dir = PHYS_TO_VIRT(cr3);
+		dir[VIDMAP_PDE] = ((unsigned int)vidmem_pagetable) | (US | RW | P);
+	}
+	invalidate_page(VIDMAP_ADDR + dest_page * ENTRY_SIZE);
+}
+/*
+ * int32_t fault_in_page(pcb_t* pcb, uint32_t addr)
+ * Description: maps a zeroed frame at the page of addr in a process's user window and
+ *				fills it from every file region that covers it, so a page shared by the
+ *				end of one segment and the start of the next gets both. A page only text
+ *				covers is mapped read-only from the program's shared text, and read
+ *				into it if no process has yet. A page that was swapped out is
+ *				decompressed instead.
+ * Inputs: pcb_t* pcb - process the page belongs to
+ * 		   uint32_t addr - user address inside the 4MB window at VIRTUAL_MEM_ADDR
+ * Outputs: None
+ * Return Value: 0 on success, -1 if addr is in no region, already mapped, the file
+ *				 couldn't be read or frames ran out
+ * Side Effects: None, a page that wasn't present can't be in the tlb
+ */
+int32_t fault_in_page(pcb_t* pcb, uint32_t addr)
+{
+	uint32_t* table = PHYS_TO_VIRT(pcb->user_table);
+	uint32_t page = addr & ~(ENTRY_SIZE - 1);
+	uint32_t frame, from, to, i, found = 0;
+	uint32_t shared = pcb->text != NULL;
+	region_t* region;
+	uint8_t* data;
+
+	if(table[USER_PTE(page)] & P)
+		return -1;
+	if(table[USER_PTE(page)] & SWAPPED)
+		return swap_in(&table[USER_PTE(page)]);
+	for(i = 0; i < pcb->region_count; i++){
+		if(page >= pcb->regions[i].start && page < pcb->regions[i].end){
+			found = 1;
+			if(pcb->regions[i].type != REGION_TEXT)
+				shared = 0;
+		}
+	}
+	if(!found)
+		return -1;
+
+	if(shared && (frame = text_frame(pcb->text, page)) != 0){
+		frame_share(frame);
+		table[USER_PTE(page)] = frame | (US | P);
+		return 0;
+	}
+	if((frame = swap_frame_alloc(1)) == 0)
+		return -1;
+	data = PHYS_TO_VIRT(frame);
+	for(i = 0; i < pcb->region_count; i++){
+		region = &pcb->regions[i];
+		if(region->type != REGION_FILE && region->type != REGION_TEXT)
+			continue;
+		from = region->vaddr > page ? region->vaddr : page;
+		to = region->file_end < page + ENTRY_SIZE ? region->file_end : page + ENTRY_SIZE;
+		if(from >= to)
+			continue;
+		if(read_data(region->inode, region->offset + (from - region->vaddr), data + (from - page), to - from) != to - from){
+			frame_free(frame, 0);
+			return -1;
+		}
+	}
+	if(shared){
+		text_add_frame(pcb->text, page, frame);
+		table[USER_PTE(page)] = frame | (US | P);
+	} else {
+		table[USER_PTE(page)] = frame | (US | RW | P);
+	}
+	return 0;
+}
+
+
+/*
+ * int32_t cow_fault(pcb_t* pcb, uint32_t addr)
+ * Description: gives a process its own copy of a copy-on-write page it wrote to. The
+ *				last process still sharing the frame just takes it over.
+ * Inputs: pcb_t* pcb - current process
+ * 		   uint32_t addr - user address that was written
+ * Outputs: None
+ * Return Value: 0 on success, -1 if the page isn't copy-on-write or frames ran out
+ * Side Effects: Invalidates the page's tlb entry
+ */
+int32_t cow_fault(pcb_t* pcb, uint32_t addr)
+{
+	uint32_t* table = PHYS_TO_VIRT(pcb->user_table);
+	uint32_t entry = table[USER_PTE(addr)];
+	uint32_t old = entry & ~(ENTRY_SIZE - 1);
+	uint32_t frame;
+
+	if((entry & (P | COW)) != (P | COW))
+		return -1;
+	if(frame_refcount(old) == 1){
+		frame = old;
+	} else {
+		if((frame = swap_frame_alloc(0)) == 0)
+			return -1;
+		memcpy(PHYS_TO_VIRT(frame), PHYS_TO_VIRT(old), ENTRY_SIZE);
+		frame_put(old);
+	}
+	table[USER_PTE(addr)] = frame | (US | RW | P);
+	invalidate_page(addr);
+	return 0;
+}
+
+
+/*
+ * int32_t handle_page_fault(uint32_t addr, uint32_t error)
+ * Description: tries to resolve a page fault by faulting in the page of the current
+ *				process it hit, or copying it if it was a write to a copy-on-write page.
+ *				Faults from the kernel touching a user buffer count too.
+ * Inputs: uint32_t addr - faulting address, from cr2
+ * 		   uint32_t error - error code the cpu pushed
+ * Outputs: None
+ * Return Value: 0 if the access can be retried, -1 if the fault is a real one
+ * Side Effects: None
+ */
+int32_t handle_page_fault(uint32_t addr, uint32_t error)
+{
+	pcb_t* pcb = get_pcb_address();
+
+	if(pcb->pid < 0 || addr < VIRTUAL_MEM_ADDR || addr >= VIRTUAL_MEM_ADDR + _4MB)
+		return -1;
+	if(error & PF_PRESENT)
+		return (error & PF_WRITE) ? cow_fault(pcb, addr) : -1;
+	return fault_in_page(pcb, addr);
+}
+
+
+/*
+ * void share_user_pages(uint32_t dst_table, uint32_t src_table)
+ * Description: maps every page of one user window into an empty one, read-only and
+ *				copy-on-write in both, for fork. The source's writable pages lose their
+ *				RW bit, so the caller flushes the tlb if it is the current process.
+ *				Read-only text pages are just shared, and so are the swap slots of
+ *				swapped out pages.
+ * Inputs: uint32_t dst_table - physical addr of the new process's (empty) user page table
+ * 		   uint32_t src_table - physical addr of the user page table to share
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void share_user_pages(uint32_t dst_table, uint32_t src_table)
+{
+	uint32_t* dst = PHYS_TO_VIRT(dst_table);
+	uint32_t* src = PHYS_TO_VIRT(src_table);
+	uint32_t i;
+
+	for(i = 0; i < PAGES_NUM; i++){
+		if(src[i] & SWAPPED){
+			dst[i] = src[i];
+			swap_share(src[i]);
+			continue;
+		}
+		if(!(src[i] & P))
+			continue;
+		if(src[i] & RW)
+			src[i] = (src[i] & ~RW) | COW;
+		dst[i] = src[i];
+		frame_share(src[i] & ~(ENTRY_SIZE - 1));
+	}
+}
+
+
+/*
+ * void fork_address_space(pcb_t* child, pcb_t* parent)
+ * Description: gives a forked child the parent's user window, copy-on-write, and the
+ *				same mmap window and vidmap page. The mmap pages are read-only file data
+ *				and the video page isn't the process's, so those are plainly copied.
+ * Inputs: pcb_t* child - new process from process_alloc
+ * 		   pcb_t* parent - current process
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Flushes the tlb, the parent's pages just became read-only
+ */
+void fork_address_space(pcb_t* child, pcb_t* parent)
+{
+	uint32_t* child_dir = PHYS_TO_VIRT(child->cr3);
+	uint32_t* parent_dir = PHYS_TO_VIRT(parent->cr3);
+
+	share_user_pages(child->user_table, parent->user_table);
+	memcpy(PHYS_TO_VIRT(child->mmap_table), PHYS_TO_VIRT(parent->mmap_table), ENTRY_SIZE);
+	child->mmap_next = parent->mmap_next;
+	child_dir[VIDMAP_PDE] = parent_dir[VIDMAP_PDE];
+	flush_tlb();
+}
+
+
+/*
+ * int32_t set_heap_end(pcb_t* pcb, uint32_t brk)
+ * Description: moves a process's program break. Growing only widens the heap region,
+ *				its pages are faulted in when touched. Shrinking unmaps the pages past
+ *				the new end. The heap can't reach into the stack region.
+ * Inputs: pcb_t* pcb - current process
+ * 		   uint32_t brk - new program break
+ * Outputs: None
+ * Return Value: 0 on success, -1 if brk is below the heap or past the stack's start
+ * Side Effects: Invalidates the tlb entries of pages it unmaps
+ */
+int32_t set_heap_end(pcb_t* pcb, uint32_t brk)
+{
+	uint32_t* table = PHYS_TO_VIRT(pcb->user_table);
+	region_t* heap = NULL;
+	region_t* stack = NULL;
+	uint32_t end, page, i;
+
+	for(i = 0; i < pcb->region_count; i++){
+		if(pcb->regions[i].type == REGION_HEAP)
+			heap = &pcb->regions[i];
+		else if(pcb->regions[i].type == REGION_STACK)
+			stack = &pcb->regions[i];
+	}
+	end = (brk + ENTRY_SIZE - 1) & ~(ENTRY_SIZE - 1);
+	if(heap == NULL || brk < heap->start || end < brk || (stack != NULL && end > stack->start))
+		return -1;
+
+	for(page = end; page < heap->end; page += ENTRY_SIZE){
+		if(table[USER_PTE(page)] & P){
+			frame_put(table[USER_PTE(page)] & ~(ENTRY_SIZE - 1));
+			table[USER_PTE(page)] = 0;
+			invalidate_page(page);
+		} else if(table[USER_PTE(page)] & SWAPPED){
+			swap_put(table[USER_PTE(page)]);
+			table[USER_PTE(page)] = 0;
+		}
+	}
+	heap->end = end;
+	pcb->brk = brk;
+	return 0;
+}
+
+
+/*
+ * uint32_t free_user_pages(uint32_t user_table)
+ * Description: drops every page mapped or swapped out in a process's user window,
+ *				frames and swap slots no other process shares are given back. The page
+ *				table itself is left to the caller
+ * Inputs: uint32_t user_table - physical addr of the user page table
+ * Outputs: None
+ * Return Value: number of pages unmapped
+ * Side Effects: None
+ */
+uint32_t free_user_pages(uint32_t user_table)
+{
+	uint32_t* table = PHYS_TO_VIRT(user_table);
+	uint32_t i, freed = 0;
+
+	for(i = 0; i < PAGES_NUM; i++){
+		if(table[i] & P){
+			frame_put(table[i] & ~(ENTRY_SIZE - 1));
+			table[i] = 0;
+			freed++;
+		} else if(table[i] & SWAPPED){
+			swap_put(table[i]);
+			table[i] = 0;
+			freed++;
+		}
+	}
+	return freed;
+}
+
+
+/*
+ * void reset_mmap(int32_t pid)
+ * Description: drops every mapping in a process's mmap window, used when a process is created
+ * Inputs: int32_t pid - process to reset
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void reset_mmap(int32_t pid)
+{
+	pcb_t* pcb = get_pcb(pid);
+
+	memset(PHYS_TO_VIRT(pcb->mmap_table), 0, ENTRY_SIZE);
+	pcb->mmap_next = 0;
+}
+
+
+/*
+ * int32_t reserve_mmap_pages(int32_t pid, uint32_t num_pages)
+ * Description: reserves a run of consecutive pages in a process's mmap window
+ * Inputs: int32_t pid - process to reserve in
+ * 		   uint32_t num_pages - number of 4KB pages needed
+ * Outputs: None
+ * Return Value: index of the first page reserved, -1 if the window is full
+ * Side Effects: None
+ */
+int32_t reserve_mmap_pages(int32_t pid, uint32_t num_pages)
+{
+	pcb_t* pcb = get_pcb(pid);
+	uint32_t first = pcb->mmap_next;
+
+	if(num_pages > PAGES_NUM - first)
+		return -1;
+	pcb->mmap_next += num_pages;
+	return first;
+}
+
+
+/*
+ * void release_mmap_pages(int32_t pid, uint32_t first, uint32_t num_pages)
+ * Description: unmaps the pages of the latest reservation in a process's mmap window
+ *				and gives the run back, for a mmap that failed partway
+ * Inputs: int32_t pid - process to release in
+ * 		   uint32_t first - first page, as reserve_mmap_pages returned it
+ * 		   uint32_t num_pages - number of pages reserved
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Invalidates the tlb entries of the pages
+ */
+void release_mmap_pages(int32_t pid, uint32_t first, uint32_t num_pages)
+{
+	pcb_t* pcb = get_pcb(pid);
+	uint32_t* table = PHYS_TO_VIRT(pcb->mmap_table);
+	uint32_t page;
+
+	for(page = first; page < first + num_pages; page++){
+		table[page] = 0;
+		invalidate_page(MMAP_ADDR + page * ENTRY_SIZE);
+	}
+	if(pcb->mmap_next == first + num_pages)
+		pcb->mmap_next = first;
+}
+
+
+/*
+ * int32_t mmap_page_mapped(uint32_t phys_addr)
+ * Description: checks whether any process has a page mapped in its mmap window, so the
+ *				filesystem doesn't free a datablock someone can still see
+ * Inputs: uint32_t phys_addr - 4KB aligned physical addr of the page
+ * Outputs: None
+ * Return Value: 1 if some process maps it, 0 if none does
+ * Side Effects: None
+ */
+int32_t mmap_page_mapped(uint32_t phys_addr)
+{
+	uint32_t pid, page;
+	uint32_t* table;
+	pcb_t* pcb;
+
+	for(pid = 0; pid < NUM_PROCESS; pid++){
+		if((pcb = get_pcb(pid)) == NULL)
+			continue;
+		table = PHYS_TO_VIRT(pcb->mmap_table);
+		for(page = 0; page < pcb->mmap_next; page++){
+			if((table[page] & P) && (table[page] & ~(ENTRY_SIZE - 1)) == phys_addr)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * void map_mmap_page(int32_t pid, uint32_t page, uint32_t phys_addr)
+ * Description: maps a 4KB physical page read-only into the current process's mmap window
+ * Inputs: int32_t pid - process to map into
+ * 		   uint32_t page - index of the page in the mmap window
+ * 		   uint32_t phys_addr - 4KB aligned physical addr to map
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void map_mmap_page(int32_t pid, uint32_t page, uint32_t phys_addr)
+{
+	uint32_t* table = PHYS_TO_VIRT(get_pcb(pid)->mmap_table);
 
-    	vidmem_pagetable[dest_page] = phys_addr | (US | RW | P); 
-		
-    	page_directory[pagedir_entry] = ((unsigned int)vidmem_pagetable) | (US | RW | P);
-    }
-    flush_tlb();
+	table[page] = phys_addr | (US | P);	/* user, read-only */
+	invalidate_page(MMAP_ADDR + page * ENTRY_SIZE);
 }
 /*
 void save_vidmem (int32_t tid) 
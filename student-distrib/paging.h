@@ -8,22 +8,50 @@
 #define P   0x01    // Present flag
 #define RW  0x02    // Read/Write flag
 #define US  0x04    // User/Supervisor flag
+#define G   0x100   // Global flag, the tlb keeps the entry across cr3 reloads (needs CR4.PGE)
+#define COW 0x200   // Available bit: read-only user page shared by fork, copied on the first write
+#define SWAPPED 0x400   // Available bit: not present user page compressed in swap slot (entry >> 12)
+#define ACCESSED 0x20   // Accessed flag, set by the cpu when the page is used
 #define PAGES_NUM 0x400                      /* Number of pages per directory/table 	*/
 #define ENTRY_SIZE 0x1000                   /* Size of page entries 				*/
 #define ENTRY_4MB 0x80                            /* 4 MB */
 #define KERNEL_ADDR 0x400000				/* Address of kernel					*/
 #define VIDMEM 0xB8						/* Address of video memory				*/
+#define USER_PDE 32							/* Page directory entry of the user page table (program and stack)	*/
+#define USER_PTE(addr) (((addr) >> 12) & (PAGES_NUM - 1))	/* entry of a user address in its page table */
+#define VIDMAP_PDE 33						/* Page directory entry of the vidmap page table	*/
+#define VIDMAP_ADDR 0x08400000				/* Virtual address vidmap maps video memory at (132MB)	*/
+#define MMAP_PDE 34							/* Page directory entry of the mmap window	*/
+#define MMAP_ADDR 0x08800000				/* Virtual address of the mmap window (136MB)	*/
+#define PF_PRESENT 0x01						/* Page fault error code: the page was present (protection fault)	*/
+#define PF_WRITE 0x02						/* Page fault error code: the access was a write	*/
 #ifndef ASM
 
+struct pcb_t;
+
 extern uint32_t page_directory[PAGES_NUM] __attribute__((aligned(ENTRY_SIZE)));
 extern uint32_t page_table[PAGES_NUM] __attribute__((aligned(ENTRY_SIZE)));
 
 
 //Initializes and enables paging
 void initPaging();
-void set_process_page(int32_t addr);
 void flush_tlb();
+void build_page_directory(uint32_t dir_addr, uint32_t user_table, uint32_t mmap_table);
+int32_t fault_in_page(struct pcb_t* pcb, uint32_t addr);
+int32_t cow_fault(struct pcb_t* pcb, uint32_t addr);
+int32_t handle_page_fault(uint32_t addr, uint32_t error);
+void share_user_pages(uint32_t dst_table, uint32_t src_table);
+void fork_address_space(struct pcb_t* child, struct pcb_t* parent);
+int32_t set_heap_end(struct pcb_t* pcb, uint32_t brk);
+uint32_t free_user_pages(uint32_t user_table);
+void switch_page_directory(uint32_t dir);
+void invalidate_page(uint32_t virt_addr);
 void map2user(uint32_t phys_addr, uint32_t dest_page, uint8_t type);
+void reset_mmap(int32_t pid);
+int32_t reserve_mmap_pages(int32_t pid, uint32_t num_pages);
+void release_mmap_pages(int32_t pid, uint32_t first, uint32_t num_pages);
+int32_t mmap_page_mapped(uint32_t phys_addr);
+void map_mmap_page(int32_t pid, uint32_t page, uint32_t phys_addr);
 //void save_vidmem (int32_t tid);
 //void restore_vidmem();
 //Helper function for initPaging used to enable paging
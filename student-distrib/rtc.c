@@ -1,6 +1,7 @@
 #include "rtc.h"
 #include "intr_handler.h"
 #include "lib.h"
+#include "frame.h"
 #include "idt.h"
 
 volatile int32_t int_flag = 0; // init flag for interrupts
@@ -78,7 +79,7 @@ int32_t rtc_read (int32_t fd, void* buf, int32_t nbytes)
 {
 	int_flag = 0;	// make sure goes into while loop
 	while(!int_flag) {
-		
+		frame_zero_idle();	// nothing else to do until the interrupt
 	}
 	// interrupt occurred
 	int_flag = 0;	// reset interrupt flag
@@ -50,7 +50,7 @@ void pit_intr()
  * Inputs: None
  * Outputs: None
  * Return Value: None
- * Side Effect: flush tlb
+ * Side Effect: loads the next process's page directory
  */
 void scheduling() 
 {
@@ -113,19 +113,19 @@ void scheduling()
 	//TODO:
 	uint8_t cur_term = get_current_terminal();
 	if (cur_term != running_term)
-		map2user((uint32_t)(VIDEO + (running_term + 1) * ENTRY_SIZE), 0, 1);
+		map2user((uint32_t)(VIDEO + (running_term + 1) * ENTRY_SIZE), 0, 0);
 	else 
-		map2user((uint32_t)VIDEO, 0 , 1);
+		map2user((uint32_t)VIDEO, 0 , 0);
 	//save_vidmem(running_term);
 
 	/* get pointer to next process */
 	pcb_t* next_process = get_pcb_args(running_term);
 	/* switch page to next terminal's process */
-	set_process_page(_8MB + (next_process->pid * _4MB));
+	switch_page_directory(next_process->cr3);
 	
 	/* point tss to next process */
 	tss.ss0 = KERNEL_DS;
-	tss.esp0 = _8MB - (next_process->pid * _8KB);
+	tss.esp0 = KERNEL_STACK_TOP(next_process);
 	/* send end of intr signal, pit has the highest prio */
 	send_eoi(PIT_IRQ);
 	/* load registers */
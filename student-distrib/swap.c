@@ -0,0 +1,226 @@
+/* swap.c - compresses cold user pages into kernel memory
+ *
+ * When free frames run low, a clock hand walks the user page tables of every
+ * process. A page the cpu marked accessed since the hand last passed gets
+ * its accessed bit cleared and a second chance; one that wasn't is LZ4
+ * compressed into a kmalloc block and its frame given back. The page table
+ * entry is left not present with the SWAPPED bit and the slot holding the
+ * block, so the next touch faults, and fault_in_page decompresses the page
+ * into a new frame.
+ *
+ * Only private data pages are taken: text and pages still shared copy-on-
+ * write would need every mapping of the frame found. A page that doesn't
+ * compress to SWAP_MAX_STORED bytes stays where it is. fork shares a swapped
+ * page's slot, each process gets its own copy when it faults it back.
+ */
+
+#include "swap.h"
+#include "frame.h"
+#include "paging.h"
+#include "syscall.h"
+#include "lz4.h"
+#include "lib.h"
+
+swap_slot_t swap_slots[SWAP_SLOTS];
+uint32_t swap_used = 0;
+uint32_t swap_hint = 0;				/* where the search for a free slot starts */
+
+/* clock hand, the next entry to look at */
+uint32_t clock_pid = 0;
+uint32_t clock_pte = 0;
+
+/* compressor output, copied into a block of the size it came to */
+uint8_t swap_buf[SWAP_MAX_STORED];
+
+/*
+ * int32_t swap_out(uint32_t* entry)
+ * Inputs: uint32_t* entry - user page table entry of a present page
+ * Outputs: None
+ * Return Value: 0 if the page was compressed and its frame given back, -1 if it is
+ *				 shared or read-only, doesn't compress well enough or there is no room
+ * Side Effects: The caller invalidates the page's tlb entry if its table is loaded
+ */
+int32_t swap_out(uint32_t* entry)
+{
+	uint32_t frame = *entry & ~(ENTRY_SIZE - 1);
+	uint32_t slot, flags;
+	int32_t len;
+	uint8_t* data;
+
+	if(!(*entry & P) || !(*entry & (RW | COW)) || frame_refcount(frame) != 1)
+		return -1;
+
+	cli_and_save(flags);
+	if(swap_used == SWAP_SLOTS || (len = lz4_compress(PHYS_TO_VIRT(frame), ENTRY_SIZE, swap_buf, SWAP_MAX_STORED)) == -1){
+		restore_flags(flags);
+		return -1;
+	}
+	if((data = kmalloc(len)) == NULL){
+		restore_flags(flags);
+		return -1;
+	}
+	for(slot = swap_hint; swap_slots[slot].data != NULL; slot = (slot + 1) % SWAP_SLOTS);
+	swap_hint = (slot + 1) % SWAP_SLOTS;
+	memcpy(data, swap_buf, len);
+	swap_slots[slot].data = data;
+	swap_slots[slot].len = len;
+	swap_slots[slot].refs = 1;
+	swap_used++;
+	*entry = (slot << 12) | SWAPPED;
+	restore_flags(flags);
+
+	frame_put(frame);
+	return 0;
+}
+
+/*
+ * int32_t swap_in(uint32_t* entry)
+ * Inputs: uint32_t* entry - SWAPPED user page table entry
+ * Outputs: None
+ * Return Value: 0 if the page is back in a frame of its own, -1 if frames ran out
+ * Side Effects: None, a page that wasn't present can't be in the tlb
+ */
+int32_t swap_in(uint32_t* entry)
+{
+	swap_slot_t* slot = &swap_slots[SWAP_SLOT(*entry)];
+	uint32_t frame, flags;
+
+	if((frame = swap_frame_alloc(0)) == 0)
+		return -1;
+	cli_and_save(flags);
+	if(lz4_decompress(slot->data, slot->len, PHYS_TO_VIRT(frame), ENTRY_SIZE) != ENTRY_SIZE){
+		restore_flags(flags);
+		frame_free(frame, 0);
+		return -1;
+	}
+	swap_put(*entry);
+	*entry = frame | (US | RW | P);
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+ * void swap_share(uint32_t entry)
+ * Inputs: uint32_t entry - SWAPPED entry being copied into another page table
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void swap_share(uint32_t entry)
+{
+	uint32_t flags;
+
+	cli_and_save(flags);
+	swap_slots[SWAP_SLOT(entry)].refs++;
+	restore_flags(flags);
+}
+
+/*
+ * void swap_put(uint32_t entry)
+ * Inputs: uint32_t entry - SWAPPED entry being dropped
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Frees the slot with its last entry
+ */
+void swap_put(uint32_t entry)
+{
+	swap_slot_t* slot = &swap_slots[SWAP_SLOT(entry)];
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(--slot->refs == 0){
+		kfree(slot->data);
+		slot->data = NULL;
+		swap_used--;
+	}
+	restore_flags(flags);
+}
+
+/*
+ * uint32_t swap_reclaim(uint32_t pages)
+ * Description: moves the clock hand over the user pages of the running processes,
+ *				compressing the ones not accessed since its last pass, until enough were
+ *				stored, SWAP_TRIES were tried or every page was seen twice
+ * Inputs: uint32_t pages - number of pages wanted
+ * Outputs: None
+ * Return Value: number of pages compressed
+ * Side Effects: Invalidates the tlb entries of the current process it changes
+ */
+uint32_t swap_reclaim(uint32_t pages)
+{
+	uint32_t stored = 0, tries = 0, steps, cr3, flags;
+	uint32_t* entry;
+	pcb_t* pcb;
+
+	asm volatile ("movl %%cr3, %0" : "=r"(cr3));
+	cli_and_save(flags);
+	for(steps = 0; steps < 2 * NUM_PROCESS * PAGES_NUM && stored < pages && tries < SWAP_TRIES; steps++){
+		if((pcb = get_pcb(clock_pid)) == NULL){
+			clock_pte = PAGES_NUM - 1;
+		} else {
+			entry = (uint32_t*)PHYS_TO_VIRT(pcb->user_table) + clock_pte;
+			if((*entry & P) && (*entry & (RW | COW))){
+				if(*entry & ACCESSED){
+					*entry &= ~ACCESSED;
+				} else {
+					tries++;
+					if(swap_out(entry) == 0)
+						stored++;
+				}
+				if(pcb->cr3 == cr3)
+					invalidate_page(VIRTUAL_MEM_ADDR + clock_pte * ENTRY_SIZE);
+			}
+		}
+		if(++clock_pte == PAGES_NUM){
+			clock_pte = 0;
+			clock_pid = (clock_pid + 1) % NUM_PROCESS;
+		}
+	}
+	restore_flags(flags);
+	return stored;
+}
+
+/*
+ * void swap_make_room(uint32_t frames)
+ * Inputs: uint32_t frames - frames about to be allocated
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Reclaims a batch of pages if that would leave fewer than SWAP_LOW_FRAMES
+ */
+void swap_make_room(uint32_t frames)
+{
+	if(frame_free_count() + frame_zeroed_count() < SWAP_LOW_FRAMES + frames)
+		swap_reclaim(SWAP_BATCH);
+}
+
+/*
+ * uint32_t swap_frame_alloc(uint32_t zeroed)
+ * Description: allocates a frame for a user page, compressing cold pages first when
+ *				memory is low, and once more if the allocation fails anyway
+ * Inputs: uint32_t zeroed - nonzero if the frame has to be cleared
+ * Outputs: None
+ * Return Value: physical addr of the frame, 0 if nothing could be freed
+ * Side Effects: None
+ */
+uint32_t swap_frame_alloc(uint32_t zeroed)
+{
+	uint32_t frame;
+
+	swap_make_room(1);
+	frame = zeroed ? frame_alloc_zeroed() : frame_alloc(0);
+	if(frame == 0 && swap_reclaim(SWAP_BATCH) != 0)
+		frame = zeroed ? frame_alloc_zeroed() : frame_alloc(0);
+	return frame;
+}
+
+/*
+ * uint32_t swap_used_count()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: number of slots holding a compressed page
+ * Side Effects: None
+ */
+uint32_t swap_used_count()
+{
+	return swap_used;
+}
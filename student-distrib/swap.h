@@ -0,0 +1,35 @@
+/* swap.h - Compressed in-memory swap for cold user pages */
+
+#ifndef _SWAP_H
+#define _SWAP_H
+
+#include "types.h"
+#include "kmalloc.h"
+
+#define SWAP_SLOTS			4096		// compressed pages held at most (16MB of user pages)
+#define SWAP_MAX_STORED		KMALLOC_MAX_SIZE	// a bigger block would take a whole frame from kmalloc
+#define SWAP_LOW_FRAMES		64			// free frames below which allocations for user pages reclaim first
+#define SWAP_BATCH			16			// pages one reclaim tries to compress
+#define SWAP_TRIES			(4 * SWAP_BATCH)	// pages one reclaim compresses at most, stored or not
+#define SWAP_SLOT(entry)	((entry) >> 12)		// slot of a SWAPPED page table entry
+#ifndef ASM
+
+/* One compressed page */
+typedef struct swap_slot {
+	uint8_t* data;					/* LZ4 block from kmalloc, NULL if the slot is free */
+	uint16_t len;					/* size of the block */
+	uint16_t refs;					/* page table entries pointing at the slot, forked processes share it */
+} swap_slot_t;
+
+int32_t swap_out(uint32_t* entry);
+int32_t swap_in(uint32_t* entry);
+void swap_share(uint32_t entry);
+void swap_put(uint32_t entry);
+uint32_t swap_reclaim(uint32_t pages);
+void swap_make_room(uint32_t frames);
+uint32_t swap_frame_alloc(uint32_t zeroed);
+uint32_t swap_used_count();
+
+#endif /* ASM */
+
+#endif /* _SWAP_H */
@@ -10,17 +10,154 @@
 #include "paging.h"
 #include "filesys.h"
 #include "scheduling.h"
+#include "elf.h"
+#include "tmpfs.h"
+#include "frame.h"
+#include "text.h"
+#include "swap.h"
 
 /* initialize global variables */
 file_op_jumptable_t file_op = {open_file, close_file, read_file, write_file};
 file_op_jumptable_t rtc_op = {rtc_open, rtc_close, rtc_read, rtc_write};
 file_op_jumptable_t dir_op = {open_dir, close_dir, read_dir, write_dir};
+file_op_jumptable_t tmpfs_op = {tmpfs_open, tmpfs_close, tmpfs_read, tmpfs_write};
+file_op_jumptable_t tmpfs_dir_op = {tmpfs_open, tmpfs_close, tmpfs_read_dir, write_dir};
 file_op_jumptable_t stdin_op = {bad_call, bad_call, terminal_read, bad_call};
 file_op_jumptable_t stdout_op = {bad_call, bad_call, bad_call, terminal_write};
 file_op_jumptable_t do_nothing = {bad_call, bad_call, bad_call, bad_call};
 
-uint8_t process_state[6] = {0, 0, 0, 0, 0, 0};  // task switching by state of processes
+pcb_t* pcb_table[NUM_PROCESS];          // PCB of each running process by pid, NULL if the pid is free
 int8_t last_shell[3] = {-1, -1, -1};    // current pid of last shell on this terminal
+pcb_t boot_pcb;                         // stands in for the process of a terminal that has none yet
+uint32_t dead_kernel_stack = 0;         // 8kB block of the last halted process, freed once off its stack
+
+
+/*
+ * void reap_kernel_stack()
+ * Description: frees the PCB and kernel stack of the last halted process, unless the
+ *              caller is still running on that stack
+ * Inputs: None
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+static void reap_kernel_stack()
+{
+    uint32_t esp;
+
+    asm volatile ("movl %%esp, %0" : "=r"(esp));
+    if (dead_kernel_stack != 0 && esp - (uint32_t)PHYS_TO_VIRT(dead_kernel_stack) >= _8KB) {
+        frame_free(dead_kernel_stack, FRAME_ORDER_8KB);
+        dead_kernel_stack = 0;
+    }
+}
+
+/*
+ * pcb_t* process_alloc()
+ * Description: takes a free pid and allocates the frames of a new process: an 8kB block
+ *              for its PCB and kernel stack, page tables for its program and its mmap
+ *              window, and its page directory. The program's own pages are faulted
+ *              in as it touches them.
+ * Inputs: None
+ * Outputs: None
+ * Return Value: the new process's PCB, cleared except for its pid and frames,
+ *               NULL if there is no free pid or not enough memory
+ * Side Effects: Compresses cold pages of other processes if memory is low
+ */
+static pcb_t* process_alloc()
+{
+    uint32_t pid, stack, user_table, table, dir;
+    pcb_t* pcb;
+
+    reap_kernel_stack();
+    for (pid = 0; pid < NUM_PROCESS && pcb_table[pid] != NULL; pid++);
+    if (pid == NUM_PROCESS)
+        return NULL;
+    swap_make_room(5);      /* kernel stack (2 frames), the two page tables and the directory */
+
+    stack = frame_alloc(FRAME_ORDER_8KB);
+    user_table = frame_alloc_zeroed();
+    table = frame_alloc(0);
+    dir = frame_alloc(0);
+    if (stack == 0 || user_table == 0 || table == 0 || dir == 0) {
+        frame_free(stack, FRAME_ORDER_8KB);
+        frame_free(user_table, 0);
+        frame_free(table, 0);
+        frame_free(dir, 0);
+        return NULL;
+    }
+    build_page_directory(dir, user_table, table);
+
+    pcb = PHYS_TO_VIRT(stack);
+    memset(pcb, 0, sizeof(pcb_t));
+    pcb->pid = pid;
+    pcb->user_table = user_table;
+    pcb->mmap_table = table;
+    pcb->cr3 = dir;
+    pcb_table[pid] = pcb;
+    return pcb;
+}
+
+/*
+ * void regions_retain(pcb_t* pcb)
+ * Description: counts a process's file and text regions against their inodes, so
+ *              the program file can't change while pages are still faulted in from it
+ * Inputs: pcb_t* pcb - process whose regions were just set up or copied
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+static void regions_retain(pcb_t* pcb)
+{
+    uint32_t i;
+
+    for (i = 0; i < pcb->region_count; i++) {
+        if (pcb->regions[i].type == REGION_FILE || pcb->regions[i].type == REGION_TEXT)
+            inode_exec_retain(pcb->regions[i].inode);
+    }
+}
+
+/*
+ * void regions_put(pcb_t* pcb)
+ * Description: drops the counts regions_retain took
+ * Inputs: pcb_t* pcb - process being freed
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+static void regions_put(pcb_t* pcb)
+{
+    uint32_t i;
+
+    for (i = 0; i < pcb->region_count; i++) {
+        if (pcb->regions[i].type == REGION_FILE || pcb->regions[i].type == REGION_TEXT)
+            inode_exec_put(pcb->regions[i].inode);
+    }
+}
+
+/*
+ * void process_free(pcb_t* pcb)
+ * Description: releases the pid and frames of a halting process. The PCB and kernel
+ *              stack stay valid until the next process_alloc or process_free made from
+ *              another stack, so halt can keep using them. Its page directory must not
+ *              be the current one.
+ * Inputs: pcb_t* pcb - process to free
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+static void process_free(pcb_t* pcb)
+{
+    reap_kernel_stack();
+    pcb_table[pcb->pid] = NULL;
+    free_user_pages(pcb->user_table);
+    frame_free(pcb->user_table, 0);
+    regions_put(pcb);
+    text_put(pcb->text);
+    frame_free(pcb->mmap_table, 0);
+    frame_free(pcb->cr3, 0);
+    dead_kernel_stack = VIRT_TO_PHYS(pcb);
+}
 
 
 /* 
@@ -46,7 +183,7 @@ int32_t halt (uint8_t status)
     // first, decrement number of proc in current terminal 
     terminals[cur_term].num_proc = terminals[cur_term].num_proc - 1;
 	// check if we are trying to halt an inactive process
-	if(process_state[cur_process->pid] == 0) {
+	if(get_pcb(cur_process->pid) != cur_process) {
 		printf("halt error: inactive process\n");
 		return -1;
 	}
@@ -59,8 +196,7 @@ int32_t halt (uint8_t status)
     
 	// mark process as no longer active
     int i;  // loop index
-	process_state[cur_process->pid] = 0;
-    for(i = 0; i < 4; i++) {
+    for(i = 0; i < TERM_MAX_PROC; i++) {
         if(terminals[cur_term].processes[i] == cur_process->pid) {
 			terminals[cur_term].processes[i] = -1;
 			break;
@@ -79,6 +215,10 @@ int32_t halt (uint8_t status)
     	}
         cur_process->file[i].file_op = &do_nothing;
   	}
+	// give back its frames, the PCB and kernel stack last of all. Its page directory is
+	// one of them, so leave it for the kernel's first.
+	switch_page_directory(0);
+	process_free(cur_process);
 
 	// run a new shell if last one halted
 	if(is_process0) {
@@ -86,10 +226,11 @@ int32_t halt (uint8_t status)
 	}
 
 	// switch page back to parent process
-	set_process_page(_8MB + (cur_process->parent_pid * _4MB));
+	pcb_t* parent = get_pcb(cur_process->parent_pid);
+	switch_page_directory(parent->cr3);
 
 	// point tss to parent process
-	tss.esp0 = _8MB - (cur_process->parent_pid * _8KB) - 4;
+	tss.esp0 = KERNEL_STACK_TOP(parent);
 	
 	
     //printf("%d\n", actual_status);
@@ -129,33 +270,15 @@ int32_t execute (const uint8_t* command)
         printf("execute error: command error\n");
         return -1;  // failure
     }
-	if (process_state[0] == 1 && process_state[1] == 1 && process_state[2] == 1
-        && process_state[3] == 1 && process_state[4] == 1 && process_state[5] == 1) {
-		printf("execute: no available process(es)\n");
-		return -1;  // failure
-	}
-
-    if (terminals[cur_term].num_proc > 3) {
+    if (terminals[cur_term].num_proc >= TERM_MAX_PROC) {
         printf("execute: no available process(es)\n");
         return -1;  // failure
     }
     /* init variables */
-    int8_t exe_identifier[4] = {0x7f, 0x45, 0x4c, 0x46};
-    uint8_t fname[33];
-    uint8_t active_pid;
+    uint8_t fname[PATH_LEN+1];
     int i; // loop index
     //int fname_len = 0;     // length of file name
-    uint32_t length = len_inodes;
-    uint8_t file_data[(int)length];
-    /* initialize process */
-    /* activate process by order */
-    for (i = 0; i < 6; i++) {
-        if (process_state[i] == 0) {
-            process_state[i] = 1;
-            active_pid = i;
-            break;
-        }
-    }
+    elf_image_t image;
 
     /* parse: arg and fname */
     int8_t arg[CMD_LEN+1];
@@ -173,7 +296,7 @@ int32_t execute (const uint8_t* command)
     for(i = 0; i < strlen((int8_t*)command); i++){
 
         if(command[i] != ' ' && (command_flag == 0 || command_flag == 1)){
-            if(exe_idx >= 32){
+            if(exe_idx >= PATH_LEN){
                 printf("execute error: filename too long\n");
                 return -1;
             }
@@ -206,19 +329,12 @@ int32_t execute (const uint8_t* command)
     /* Retrieve file dentry */
     if(read_dentry_by_name(fname, &dentry) == -1) {
         printf("execute error: file not found\n");
-        process_state[active_pid] = 0;
         return -1;  // failure
     }
 
-    /* Read first 4 bytes of data */
-
-    uint16_t nbytes = read_data(dentry.inode_num, 0, file_data, length);
-    /* exe check */
-    /* user-level program loader*/
-    /* Check to see if strings are the same */
-    if(strncmp((int8_t*)file_data, exe_identifier, 4) != 0){
+    /* exe check: read only the ELF header and program headers */
+    if(elf_check(dentry.inode_num, &image) == -1){
         printf("execute error: file not an executable\n");
-        process_state[active_pid] = 0;
         return -1;  // not an exe file
     }
 
@@ -240,9 +356,19 @@ int32_t execute (const uint8_t* command)
     // overwrite with esp and ebp from scheduling
     //pcb_t pcb;
     */
-    pcb_t* cur_process = (pcb_t*)(_8MB - (_8KB * (active_pid + 1)));
-    uint8_t cur_pid = active_pid;
-    cur_process->pid = cur_pid;
+    /* take a pid, and frames for the PCB, kernel stack and program */
+    pcb_t* cur_process = process_alloc();
+    if (cur_process == NULL) {
+        printf("execute: no available process(es)\n");
+        return -1;  // failure
+    }
+    uint8_t cur_pid = cur_process->pid;
+
+    /* segments, heap and stack, their pages are faulted in on first touch. Text pages
+       come from the program's shared text when another process has read them. */
+    elf_regions(&image, cur_process);
+    regions_retain(cur_process);
+    cur_process->text = text_get(dentry.inode_num);
 
     /* set scheduling flag */
     //cur_process->sche_enable = 0;
@@ -258,7 +384,7 @@ int32_t execute (const uint8_t* command)
         terminals[cur_term].processes[0] = cur_pid; // assign current process as base shell 
         terminals[cur_term].first_run = 0;          // clear first run flag
     } else {
-        for (i = 0; i < 4; i++) {
+        for (i = 0; i < TERM_MAX_PROC; i++) {
             if (terminals[cur_term].processes[i] == -1) {   // check all processes under current terminal
                 terminals[cur_term].processes[i] = cur_pid; // assign current process as the last process
                 break;
@@ -299,13 +425,11 @@ int32_t execute (const uint8_t* command)
     When processing the execute system call, your kernel
     must create a virtual address space for the new process. 
     This will involve setting up a new Page Directory with entries. */
-    /* starting at physical 8MB, setup a 4MB page dir entry */
-    set_process_page(_8MB + (cur_pid * _4MB)); 
+    /* switch to the process's own page directory, nothing of the program is read yet */
+    reset_mmap(cur_pid);
+    switch_page_directory(cur_process->cr3);
     /* The program image itself is linked to execute at virtual address 0x08048000 */
 
-    uint8_t* program_image_addr = (uint8_t*)PROGRAM_IMG_ADDR;   // copy to program img addr at virtual
-    memcpy(program_image_addr, file_data, nbytes);
-
 
     /* save parent esp */
     uint32_t parent_esp;
@@ -324,12 +448,9 @@ int32_t execute (const uint8_t* command)
     // set process to current running terminal
     terminals[running_term].term_proc = cur_process;
     // entry point
-    uint8_t entry_ptr[4];
+    uint32_t* entry_ptr = &image.header.e_entry;
     /* context switch */
-    //  The EIP you need to jump to is the entry point from bytes 24-27 of the executable that you have just loaded
-    for (i = 0; i < 4; i++) {
-        entry_ptr[i] = file_data[i + 24]; 
-    }
+    //  The EIP you need to jump to is e_entry from the ELF header that was checked above
     
     /* the important fields are SS0 and ESP0. 
     These fields contain the stack segment and stack pointer that 
@@ -340,7 +461,7 @@ int32_t execute (const uint8_t* command)
     These fields must be set to point to the kernel's stack segment 
     and the process's kernel-mode stack, respectively */
     tss.ss0 = KERNEL_DS;
-    tss.esp0 = _8MB - (cur_pid * _8KB) - 4;
+    tss.esp0 = KERNEL_STACK_TOP(cur_process);
 
     /* Push IRET context to kernel stack */
 	asm volatile (
@@ -435,14 +556,15 @@ int32_t write (int32_t fd, const void* buf, int32_t nbytes)
 int32_t open (const uint8_t* filename)
 {
     int32_t fd;                           // minimum FD value
+    int32_t tmpfs_inode;
     pcb_t* pcb = get_pcb_address();
     dentry_t dentry;
     // filename too long or no filename entered
-    if (strlen((int8_t*)filename) > 32 || strlen((int8_t*)filename) == 0){
+    if (strlen((int8_t*)filename) > PATH_LEN || strlen((int8_t*)filename) == 0){
         return -1;
     }
-    // read dentry failed
-	if (read_dentry_by_name(filename, &dentry)==-1) 
+    // read dentry failed, tmp/ isn't in the filesystem image
+	if (tmpfs_name(filename) == NULL && read_dentry_by_name(filename, &dentry)==-1) 
 		return -1;
 
     for (fd = 2; fd < 8; fd++) {
@@ -452,7 +574,18 @@ int32_t open (const uint8_t* filename)
         }
     }
     if (pcb->file[fd].flags != 1) {
-        if(dentry.file_type == 0 || !strncmp((int8_t*)filename, "rtc", 3)){                // if we are dealing with the rtc
+        if(tmpfs_name(filename) != NULL){                // if we are dealing with tmp/ or a file in it
+            if((tmpfs_inode = tmpfs_open(filename)) != -1){
+                pcb->file[fd].file_op = tmpfs_inode == TMPFS_ROOT ? &tmpfs_dir_op : &tmpfs_op;
+                pcb->file[fd].pos = 0;
+                pcb->file[fd].inode = tmpfs_inode;
+                pcb->file[fd].flags = 1;
+                return fd;
+            } else {
+                return -1;
+            }
+        }
+        else if(dentry.file_type == 0 || !strncmp((int8_t*)filename, "rtc", 3)){                // if we are dealing with the rtc
             if(rtc_open(filename) != -1){
                 pcb->file[fd].file_op = &rtc_op;
                 pcb->file[fd].pos = 0;
@@ -467,7 +600,7 @@ int32_t open (const uint8_t* filename)
             if(open_dir(filename) != -1){
                 pcb->file[fd].file_op = &dir_op;
                 pcb->file[fd].pos = 0;
-                pcb->file[fd].inode = 0;
+                pcb->file[fd].inode = dentry_dir_inode(&dentry);  // where read_dir finds the dentries
                 pcb->file[fd].flags = 1;
                 return fd;
             } else {
@@ -600,6 +733,391 @@ int32_t sigreturn (void)
     return -1;
 }
 
+/*
+ * int32_t mmap (int32_t fd, uint8_t** start)
+ * Description: This function maps the datablocks of an open file read-only into the caller's
+ *				mmap window without copying them. The datablocks of the filesystem image are
+ *				4KB aligned, so each one is mapped as a page in file order.
+ * Inputs:  int32_t fd - file descriptor of an open regular file
+ *          uint8_t** start - filled in with the user address of the first byte of the file
+ * Outputs: None
+ * Return Value: -1 (failure), length of the file in bytes (success)
+ * Side Effects: invalidates the tlb entries of the mapped pages
+ */
+int32_t mmap (int32_t fd, uint8_t** start)
+{
+    int32_t length, first_page;
+    uint32_t num_pages, block_addr;
+    pcb_t* pcb;
+    int i;  // loop index
+
+    // null ptr, and the ptr itself must be in the user page
+    if (start == NULL || (uint32_t)start < VIRTUAL_MEM_ADDR || (uint32_t)start > VIRTUAL_MEM_ADDR + _4MB - sizeof(uint8_t*))
+        return -1;
+    if ((fd < FD_FLOOR) || (fd > FD_CAP))
+        return -1;
+    pcb = get_pcb_address();
+    // only regular files have datablocks
+    if (pcb->file[fd].flags == 0 || pcb->file[fd].file_op != &file_op)
+        return -1;
+
+    length = get_inode_length(pcb->file[fd].inode);
+    if (length <= 0)
+        return -1;
+    // datablocks of a compressed image aren't in memory as they are, so there is nothing to map
+    if (get_data_block_addr(pcb->file[fd].inode, 0) == 0)
+        return -1;
+    num_pages = (length + ABS_BLOCK_SIZE - 1) / ABS_BLOCK_SIZE;
+    first_page = reserve_mmap_pages(pcb->pid, num_pages);
+    if (first_page == -1)
+        return -1;
+
+    for (i = 0; i < num_pages; i++) {
+        block_addr = get_data_block_addr(pcb->file[fd].inode, i);
+        if (block_addr == 0) {
+            // a hole in the file, undo the pages mapped so far
+            release_mmap_pages(pcb->pid, first_page, num_pages);
+            return -1;
+        }
+        map_mmap_page(pcb->pid, first_page + i, block_addr);
+    }
+
+    *start = (uint8_t*)(MMAP_ADDR + first_page * ENTRY_SIZE);
+    return length;
+}
+
+/*
+ * int32_t getdents (int32_t fd, void* buf, int32_t nbytes)
+ * Description: System call fills a user buffer with as many directory records (name, type,
+ *				inode and length) as fit, so a listing takes one call instead of one read per entry.
+ * Inputs:  int32_t fd - file descriptor of an open directory
+ * 			void* buf - buffer for dirent_t records
+ * 			int32_t nbytes - size of buf in bytes
+ * Outputs: None
+ * Return Value: -1 (failure), bytes of records written, 0 at the end of the directory
+ * Side Effects: advances the directory position
+ */
+int32_t getdents (int32_t fd, void* buf, int32_t nbytes)
+{
+    if (buf == NULL)
+        return -1;
+    if ((fd < FD_FLOOR) || (fd > FD_CAP) || (nbytes < 0))
+        return -1;
+
+    pcb_t* pcb = get_pcb_address();
+    if (pcb->file[fd].flags == 0)
+        return -1;
+    if (pcb->file[fd].file_op == &tmpfs_dir_op)
+        return tmpfs_read_dirents(fd, buf, nbytes);
+    // only directories have records to return
+    if (pcb->file[fd].file_op != &dir_op)
+        return -1;
+
+    return read_dirents(fd, buf, nbytes);
+}
+
+/*
+ * int32_t stat (const uint8_t* filename, void* buf)
+ * Description: System call reports the type, inode and length of a file by name
+ * Inputs:  const uint8_t* filename - name of the file
+ * 			void* buf - stat_t to fill in
+ * Outputs: None
+ * Return Value: -1 (failure), 0 (success)
+ * Side Effects: None
+ */
+int32_t stat (const uint8_t* filename, void* buf)
+{
+    dentry_t dentry;
+
+    if (filename == NULL || buf == NULL)
+        return -1;
+    // filename too long or no filename entered
+    if (strlen((int8_t*)filename) > PATH_LEN || strlen((int8_t*)filename) == 0)
+        return -1;
+    if (tmpfs_name(filename) != NULL)
+        return tmpfs_stat(filename, (stat_t*)buf);
+    if (read_dentry_by_name(filename, &dentry) == -1)
+        return -1;
+
+    fill_stat(dentry.file_type, dentry.inode_num, (stat_t*)buf);
+    return 0;
+}
+
+/*
+ * int32_t fstat (int32_t fd, void* buf)
+ * Description: System call reports the type, inode and length of an open file
+ * Inputs:  int32_t fd - file descriptor
+ * 			void* buf - stat_t to fill in
+ * Outputs: None
+ * Return Value: -1 (failure), 0 (success)
+ * Side Effects: None
+ */
+int32_t fstat (int32_t fd, void* buf)
+{
+    int32_t file_type;
+
+    if (buf == NULL)
+        return -1;
+    if ((fd < FD_FLOOR) || (fd > FD_CAP))
+        return -1;
+
+    pcb_t* pcb = get_pcb_address();
+    if (pcb->file[fd].flags == 0)
+        return -1;
+
+    // the file type is implied by the operations open installed
+    if (pcb->file[fd].file_op == &file_op)
+        file_type = 2;
+    else if (pcb->file[fd].file_op == &dir_op)
+        file_type = 1;
+    else if (pcb->file[fd].file_op == &rtc_op)
+        file_type = 0;
+    else if (pcb->file[fd].file_op == &tmpfs_op || pcb->file[fd].file_op == &tmpfs_dir_op) {
+        tmpfs_fstat(fd, (stat_t*)buf);
+        return 0;
+    }
+    else
+        return -1;
+
+    fill_stat(file_type, pcb->file[fd].inode, (stat_t*)buf);
+    return 0;
+}
+
+/*
+ * int32_t lseek (int32_t fd, int32_t offset, int32_t whence)
+ * Description: System call moves the position of an open regular file
+ * Inputs:  int32_t fd - file descriptor
+ * 			int32_t offset - offset relative to whence
+ * 			int32_t whence - SEEK_SET (0), SEEK_CUR (1) or SEEK_END (2)
+ * Outputs: None
+ * Return Value: -1 (failure), new position (success)
+ * Side Effects: moves the file position
+ */
+int32_t lseek (int32_t fd, int32_t offset, int32_t whence)
+{
+    if ((fd < FD_FLOOR) || (fd > FD_CAP))
+        return -1;
+
+    pcb_t* pcb = get_pcb_address();
+    if (pcb->file[fd].flags == 0)
+        return -1;
+    if (pcb->file[fd].file_op == &tmpfs_op)
+        return tmpfs_lseek(fd, offset, whence);
+    // only regular files can seek
+    if (pcb->file[fd].file_op != &file_op)
+        return -1;
+
+    return lseek_file(fd, offset, whence);
+}
+
+/*
+ * int32_t pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset)
+ * Description: System call reads from a given offset of an open regular file
+ *				without moving its position
+ * Inputs:  int32_t fd - file descriptor
+ * 			void* buf - buffer to read
+ * 			int32_t nbytes - number of bytes to read
+ * 			int32_t offset - file offset to read from
+ * Outputs: None
+ * Return Value: -1 (failure), number of bytes read (success)
+ * Side Effects: None
+ */
+int32_t pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset)
+{
+    if (buf == NULL)
+        return -1;
+    if ((fd < FD_FLOOR) || (fd > FD_CAP) || (nbytes < 0) || (offset < 0))
+        return -1;
+
+    pcb_t* pcb = get_pcb_address();
+    if (pcb->file[fd].flags == 0)
+        return -1;
+    if (pcb->file[fd].file_op == &tmpfs_op)
+        return tmpfs_pread(fd, buf, nbytes, offset);
+    // only regular files have offsets
+    if (pcb->file[fd].file_op != &file_op)
+        return -1;
+
+    return pread_file(fd, buf, nbytes, offset);
+}
+
+/*
+ * int32_t create (const uint8_t* filename)
+ * Description: System call creates an empty regular file in tmp/, or in the filesystem
+ *				image when it is writable
+ * Inputs:  const uint8_t* filename - name of the new file
+ * Outputs: None
+ * Return Value: -1 (failure), 0 (success)
+ * Side Effects: adds a dentry and takes a free inode
+ */
+int32_t create (const uint8_t* filename)
+{
+    if (filename == NULL)
+        return -1;
+    if (tmpfs_name(filename) != NULL)
+        return tmpfs_create(filename);
+    return create_file(filename);
+}
+
+/*
+ * int32_t ftruncate (int32_t fd, int32_t length)
+ * Description: System call shrinks or grows an open regular file to length bytes
+ * Inputs:  int32_t fd - file descriptor
+ * 			int32_t length - new length of the file
+ * Outputs: None
+ * Return Value: -1 (failure), 0 (success)
+ * Side Effects: frees or allocates datablocks
+ */
+int32_t ftruncate (int32_t fd, int32_t length)
+{
+    if ((fd < FD_FLOOR) || (fd > FD_CAP) || (length < 0))
+        return -1;
+
+    pcb_t* pcb = get_pcb_address();
+    if (pcb->file[fd].flags == 0)
+        return -1;
+    if (pcb->file[fd].file_op == &tmpfs_op)
+        return tmpfs_truncate(fd, length);
+    // only regular files have datablocks
+    if (pcb->file[fd].file_op != &file_op)
+        return -1;
+
+    return truncate_file(fd, length);
+}
+
+/*
+ * int32_t unlink (const uint8_t* filename)
+ * Description: System call removes a file from tmp/. Its memory goes back to the page
+ *				pool once no fd has it open. Files in the filesystem image can't be removed.
+ * Inputs:  const uint8_t* filename - tmp/<name>
+ * Outputs: None
+ * Return Value: -1 (failure), 0 (success)
+ * Side Effects: frees the file's pages and inode
+ */
+int32_t unlink (const uint8_t* filename)
+{
+    if (filename == NULL || strlen((int8_t*)filename) > PATH_LEN)
+        return -1;
+    return tmpfs_unlink(filename);
+}
+
+/*
+ * int32_t fork_run(pcb_t* child, pcb_t* parent)
+ * Description: runs a forked child on this terminal in place of its parent, the way
+ *              execute runs a program. The child starts on a copy of the parent's
+ *              syscall_handler frame, so it leaves the same int 0x80 as the parent,
+ *              with 0 in eax.
+ * Inputs: pcb_t* child - the new process, its address space set up by fork
+ *         pcb_t* parent - the calling process
+ * Outputs: None
+ * Return Value: the child's status, halt returns to the parent through this frame
+ * Side Effects: switches to the child's page directory and kernel stack
+ */
+static int32_t __attribute__((noinline)) fork_run(pcb_t* child, pcb_t* parent)
+{
+    uint32_t* frame = (uint32_t*)(KERNEL_STACK_TOP(child) - SYSCALL_FRAME_SIZE);
+
+    memcpy(frame, (uint32_t*)(KERNEL_STACK_TOP(parent) - SYSCALL_FRAME_SIZE), SYSCALL_FRAME_SIZE);
+    asm volatile (
+        "movl   %%esp, %0;"
+        "movl   %%ebp, %1;"
+        : "=g"(child->parent_esp), "=g"(child->parent_ebp)
+    );
+    switch_page_directory(child->cr3);
+    tss.ss0 = KERNEL_DS;
+    tss.esp0 = KERNEL_STACK_TOP(child);
+    asm volatile (
+        "cli;"
+        "movl   %0, %%esp;"
+        "jmp    fork_return;"
+        :
+        : "r" (frame)
+        : "memory"
+    );
+
+    return 0;   // not reached
+}
+
+/*
+ * int32_t fork (void)
+ * Description: System call duplicates the calling process. The child shares the parent's
+ *              user pages copy-on-write, so only pages one of them writes to get copied,
+ *              and gets copies of its open files, regions, mmap window and arguments.
+ *              Like execute, the child then runs on the terminal and the parent
+ *              waits in fork until it halts.
+ * Inputs:  None
+ * Outputs: None
+ * Return Value: the child's pid to the parent, 0 to the child, -1 (failure)
+ * Side Effects: the parent's writable user pages become copy-on-write
+ */
+int32_t fork (void)
+{
+    uint8_t cur_term = get_current_terminal();
+    pcb_t* parent = get_pcb_address();
+    pcb_t* child;
+    int32_t pid;
+    int i;  // loop index
+
+    if (parent->pid < 0 || terminals[cur_term].num_proc >= TERM_MAX_PROC)
+        return -1;
+    if ((child = process_alloc()) == NULL)
+        return -1;
+    pid = child->pid;
+
+    /* the child's fds are copies of the parent's, tmp/ files count them as opens */
+    memcpy(child->file, parent->file, sizeof(child->file));
+    for (i = FD_FLOOR; i <= FD_CAP; i++) {
+        if (child->file[i].flags == 1 && (child->file[i].file_op == &tmpfs_op || child->file[i].file_op == &tmpfs_dir_op))
+            tmpfs_retain(child->file[i].inode);
+    }
+    memcpy(child->arg, parent->arg, sizeof(child->arg));
+    memcpy(child->regions, parent->regions, sizeof(child->regions));
+    child->region_count = parent->region_count;
+    regions_retain(child);
+    child->brk = parent->brk;
+    child->text = parent->text;
+    text_retain(child->text);
+    fork_address_space(child, parent);
+
+    /* the child is the terminal's process until it halts, a forked shell is its last shell */
+    child->parent_pid = parent->pid;
+    for (i = 0; i < TERM_MAX_PROC; i++) {
+        if (terminals[cur_term].processes[i] == -1) {
+            terminals[cur_term].processes[i] = pid;
+            break;
+        }
+    }
+    terminals[cur_term].num_proc = terminals[cur_term].num_proc + 1;
+    if (last_shell[cur_term] == parent->pid)
+        last_shell[cur_term] = pid;
+    terminals[cur_term].term_proc = child;
+    terminals[running_term].term_proc = child;
+
+    fork_run(child, parent);
+    return pid;
+}
+
+/*
+ * int32_t brk (void* addr)
+ * Description: System call moves the calling process's program break, the end of its
+ *              heap. The heap starts right after the program's last segment and can
+ *              grow until it meets the stack region.
+ * Inputs:  void* addr - new program break, NULL to only ask for the current one
+ * Outputs: None
+ * Return Value: the program break after the call, -1 (failure)
+ * Side Effects: pages past a lowered break are unmapped
+ */
+int32_t brk (void* addr)
+{
+    pcb_t* pcb = get_pcb_address();
+
+    if (pcb->pid < 0)
+        return -1;
+    if (addr != NULL && set_heap_end(pcb, (uint32_t)addr) == -1)
+        return -1;
+    return (int32_t)pcb->brk;
+}
+
 /* 
  * pcb_t* get_pcb_address()
  * Description: get pcb addr
@@ -615,18 +1133,18 @@ pcb_t* get_pcb_address()
     uint8_t cur_term = get_current_terminal();
     
     // find the last process running on current terminal
-    for (i = 0; i < 4; i++) {
+    for (i = 0; i < TERM_MAX_PROC; i++) {
         if(terminals[cur_term].processes[i] == -1) {
             break;
         }
     } 
-    //if (i > 0)
+    // nothing has run on this terminal yet
+    if (i == 0) {
+        boot_pcb.pid = -1;
+        return &boot_pcb;
+    }
     cur_pid = terminals[cur_term].processes[i-1];
-	//else 
-	//	return NULL;
-    //pcb_t* cur_process = (pcb_t*)(_8MB - (_8KB * (cur_pid + 1)));
-    pcb_t* cur_process = (pcb_t*)(_8MB - (_8KB * (cur_pid + 1)));
-	return cur_process;
+	return get_pcb(cur_pid);
 
 	//return terminals[cur_term].term_proc;
 	
@@ -645,14 +1163,15 @@ pcb_t* get_pcb_address()
  * get_pcb(uint32_t pid)
  * Description: retrieve pointer process given pid
  * Inputs: pid, processor id number of a process
- * Outputs: pointer to process struct
+ * Outputs: pointer to process struct, NULL if no process has the pid
  * Side Effects: none
  */
 
 pcb_t* get_pcb(uint32_t pid) 
 {
-    pcb_t* cur_process = (pcb_t*)(_8MB - (_8KB * (pid + 1)));
-    return cur_process;
+    if (pid >= NUM_PROCESS)
+        return NULL;
+    return pcb_table[pid];
 }
 
 /* 
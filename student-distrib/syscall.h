@@ -2,6 +2,7 @@
 #define SYSCALL_H
 
 #define PCB_BITMASK 0xFFFFE000 // kernel stack has 8kB alignment
+#define KERNEL_STACK_TOP(pcb)	((uint32_t)(pcb) + _8KB - 4)	// PCB at the bottom of its 8kB block, stack above
 #define _8KB 		0x2000
 #define _4MB 		0x400000
 #define _8MB		0x800000
@@ -11,6 +12,14 @@
 #define FD_CAP		7
 #define FD_FLOOR	2
 #define CMD_LEN		128
+#define NUM_PROCESS	32		// size of the pid table, free frames decide how many actually run
+#define SYSCALL_MAX	21		// highest system call number
+#define SYSCALL_FRAME_SIZE	48	// iret frame and the registers syscall_handler saves, at the top of a kernel stack
+#define MAX_REGIONS	10		// a region per PT_LOAD segment (ELF_MAX_PHDRS), the heap and the stack
+#define REGION_FILE		1	// filled from the program file, zero past the file data (data, bss)
+#define REGION_TEXT		4	// read-only part of the program file, its pages are shared
+#define REGION_HEAP		2	// zero filled, grows up
+#define REGION_STACK	3	// zero filled, grows down to its start
 #ifndef ASM
 
 /* declare global variable */
@@ -28,6 +37,17 @@ int32_t getargs (uint8_t* buf, int32_t nbytes);
 int32_t vidmap(uint8_t** screen_start);
 int32_t set_handler (int32_t signum, void* handler_address);
 int32_t sigreturn (void);
+int32_t mmap (int32_t fd, uint8_t** start);
+int32_t getdents (int32_t fd, void* buf, int32_t nbytes);
+int32_t stat (const uint8_t* filename, void* buf);
+int32_t fstat (int32_t fd, void* buf);
+int32_t lseek (int32_t fd, int32_t offset, int32_t whence);
+int32_t pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset);
+int32_t create (const uint8_t* filename);
+int32_t ftruncate (int32_t fd, int32_t length);
+int32_t unlink (const uint8_t* filename);
+int32_t fork (void);
+int32_t brk (void* addr);
 /* bad call, for stdin/stdout */
 int32_t bad_call();
 
@@ -47,6 +67,17 @@ typedef struct fd_t {
 	uint32_t flags; 
 } fd_t;
 
+/* a range of a process's user window that pages are faulted in for */
+typedef struct region_t {
+	uint32_t start;			// first page of the region
+	uint32_t end;			// end of the region, page aligned
+	uint32_t type;			// REGION_FILE, REGION_TEXT, REGION_HEAP or REGION_STACK
+	uint32_t inode;			// file a REGION_FILE or REGION_TEXT is read from
+	uint32_t vaddr;			// user address of the byte at offset in the file
+	uint32_t offset;		// file offset of the segment
+	uint32_t file_end;		// user address where the file data ends, the rest of the region is zero
+} region_t;
+
 typedef struct pcb_t {
     fd_t file[8];			// files processed in current process, up to 8
 	char arg[CMD_LEN + 1];	// arguments
@@ -56,8 +87,15 @@ typedef struct pcb_t {
 	uint32_t parent_esp;			// stack pointer for parent process, used to return to the parent process when this one is halted
 	uint32_t ebp;			// base pointer for current process
 	uint32_t esp;			// stack pointer for current process
-	uint32_t cr3;			// cr3 pointer for current process
+	uint32_t cr3;			// physical addr of the process's page directory, loaded into cr3
 	uint32_t sche_enable;	// flag to enable scheduling and override esp and ebp for pcb from scheduling function
+	uint32_t user_table;	// physical frame of the page table mapping the program and stack at VIRTUAL_MEM_ADDR
+	uint32_t mmap_table;	// physical frame of the page table of the mmap window
+	uint32_t mmap_next;		// next free page in the mmap window
+	region_t regions[MAX_REGIONS];	// what the pages of the user window are filled with
+	uint32_t region_count;	// regions in use
+	uint32_t brk;			// program break, the heap region ends at it rounded up to a page
+	struct shared_text* text;	// text pages shared with the other processes running the program, NULL if private
 } pcb_t;
 
 pcb_t* get_pcb_address();
@@ -5,6 +5,7 @@
 #include "syscall.h"
 #include "x86_desc.h"
 #include "scheduling.h"
+#include "frame.h"
 
 int32_t cur_term = 0;       // id of displayed terminal
 
@@ -27,7 +28,7 @@ void terminal_init()
 		terminals[i].kb_buffer_index = 0;
 		terminals[i].num_proc = 0;
 		terminals[i].term_proc = (pcb_t*)NULL;
-		for (j = 0; j < 4; j++) 
+		for (j = 0; j < TERM_MAX_PROC; j++) 
 			terminals[i].processes[j] = -1;
 	}
 	cur_term = 0;
@@ -89,12 +90,12 @@ void switch_terminal(uint8_t tid)
 	/* ================== SWITCH EXECUTION ========================= */
 	
 	// switch page back to next terminal's process
-	set_process_page(_8MB + (cur_process->pid * _4MB));
+	switch_page_directory(cur_process->cr3);
 
 	// stack switching
 	// point tss to next terminal's process	
 	tss.ss0 = KERNEL_DS;
-	tss.esp0 = _8MB - (cur_process->pid * _8KB) - 4;
+	tss.esp0 = KERNEL_STACK_TOP(cur_process);
 	
 	// load ebp and esp from next process into their registers
     asm volatile(
@@ -161,8 +162,9 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
 	/* check enter flag */
 	check_enter_pressed(&enter);
 
-	/* loop until enter is pressed */
+	/* loop until enter is pressed, clearing frames for the zeroed pool meanwhile */
 	while(enter != 1) {
+		frame_zero_idle();
 		check_enter_pressed(&enter);
 	}
 	
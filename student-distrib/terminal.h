@@ -9,9 +9,10 @@
 #define KB4     0x1000
 #define MB64    0x4000000
 #define NUM_TERM 3
+#define TERM_MAX_PROC 8		// deepest nesting of processes on one terminal
 #ifndef	ASM
 typedef struct terminal_t {
-	int8_t processes[4];	// max 4 proc on one terminal
+	int8_t processes[TERM_MAX_PROC];	// pids of the processes on this terminal, -1 after the last
 	pcb_t* term_proc;	// current process running in this terminal
 	int num_proc;		// number of processes currently active in this terminal
 	int32_t screen_x;					//x pos of cursor
@@ -6,6 +6,11 @@
 #include "rtc.h"
 #include "paging.h"
 #include "syscall.h"
+#include "tmpfs.h"
+#include "frame.h"
+#include "kmalloc.h"
+#include "text.h"
+#include "swap.h"
 
 #define PASS 1
 #define FAIL 0
@@ -17,6 +22,38 @@
 #define TEST_OUTPUT(name, result)	\
 	printf("[TEST %s] Result = %s\n", name, (result) ? "PASS" : "FAIL");
 
+/* read the cpu timestamp counter, used by the filesystem benchmarks */
+static inline uint32_t rdtsc_lo(){
+	uint32_t lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return lo;
+}
+
+/* 
+ * uint32_t tsc_mhz()
+ * Description: Calibrates the timestamp counter against a 10ms one-shot on PIT channel 2
+ * Inputs: none
+ * Outputs: timestamp counter ticks per microsecond
+ * Side Effects: Reprograms PIT channel 2 (speaker channel, unused by the kernel)
+ */
+#define PIT_CH2			0x42
+#define PIT_CMD			0x43
+#define PIT_GATE		0x61
+#define PIT_10MS		11932		// 1193182 Hz / 100
+uint32_t tsc_mhz(){
+	uint32_t start;
+	/* raise the channel 2 gate with the speaker output off */
+	outb((inb(PIT_GATE) & ~0x02) | 0x01, PIT_GATE);
+	/* channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count) */
+	outb(0xB0, PIT_CMD);
+	outb(PIT_10MS & 0xFF, PIT_CH2);
+	outb(PIT_10MS >> 8, PIT_CH2);
+	start = rdtsc_lo();
+	/* OUT2 goes high once the count runs out */
+	while(!(inb(PIT_GATE) & 0x20));
+	return (rdtsc_lo() - start) / 10000;
+}
+
 static inline void assertion_failure(){
 	/* Use exception #15 for assertions, otherwise
 	   reserved by Intel */
@@ -116,6 +153,552 @@ int KM_paging_test(){
 	return PASS;
 }
 
+/* 
+ * int global_page_test()
+ * Description: This function checks that global pages are enabled and that the kernel
+ *				page, video memory and the physical memory mapping are marked global,
+ *				while the user entries are not.
+ * Inputs: none
+ * Outputs: none
+ * Return Value: PASS 1/ FAIL 0
+ * Side Effects: none
+ */
+int global_page_test(){
+	TEST_HEADER;
+	uint32_t cr4;
+	int result = PASS;
+
+	asm volatile ("movl %%cr4, %0" : "=r"(cr4));
+	if(!(cr4 & 0x80))	// CR4.PGE
+		result = FAIL;
+	if(!(page_directory[1] & G) || !(page_directory[PHYS_MAP_PDE] & G))
+		result = FAIL;
+	if(!(page_table[VIDMEM] & G))
+		result = FAIL;
+	if(page_directory[USER_PDE] & G)
+		result = FAIL;
+	return result;
+}
+
+/* 
+ * int demand_page_test()
+ * Description: This function faults pages into a scratch process whose file region
+ *				holds the first 0x40 bytes of hello at an offset into its page, and checks
+ *				the page contents, that addresses outside the regions are refused and
+ *				that free_user_pages gives every frame back.
+ * Inputs: none
+ * Outputs: none
+ * Return Value: PASS 1/ FAIL 0
+ * Side Effects: none
+ */
+int demand_page_test(){
+	TEST_HEADER;
+	static pcb_t pcb;
+	dentry_t dentry;
+	uint8_t file[0x40];
+	uint8_t* page;
+	uint32_t* entries;
+	uint32_t before, i;
+	int result = PASS;
+
+	if(read_dentry_by_name((uint8_t*)"hello", &dentry) == -1
+		|| read_data(dentry.inode_num, 0, file, sizeof(file)) != sizeof(file))
+		return FAIL;
+	before = frame_free_count() + frame_zeroed_count();
+	memset(&pcb, 0, sizeof(pcb));
+	if((pcb.user_table = frame_alloc(0)) == 0)
+		return FAIL;
+	entries = PHYS_TO_VIRT(pcb.user_table);
+	memset(entries, 0, FRAME_SIZE);
+
+	/* a file region with 0x40 bytes of data and some bss, then a stack page */
+	pcb.regions[0].start = VIRTUAL_MEM_ADDR + 0x48000;
+	pcb.regions[0].end = VIRTUAL_MEM_ADDR + 0x4A000;
+	pcb.regions[0].type = REGION_FILE;
+	pcb.regions[0].inode = dentry.inode_num;
+	pcb.regions[0].vaddr = VIRTUAL_MEM_ADDR + 0x48100;
+	pcb.regions[0].offset = 0;
+	pcb.regions[0].file_end = VIRTUAL_MEM_ADDR + 0x48140;
+	pcb.regions[1].start = VIRTUAL_MEM_ADDR + _4MB - ENTRY_SIZE;
+	pcb.regions[1].end = VIRTUAL_MEM_ADDR + _4MB;
+	pcb.regions[1].type = REGION_STACK;
+	pcb.region_count = 2;
+
+	if(fault_in_page(&pcb, VIRTUAL_MEM_ADDR + 0x48123) == -1
+		|| fault_in_page(&pcb, VIRTUAL_MEM_ADDR + 0x49FFF) == -1
+		|| fault_in_page(&pcb, VIRTUAL_MEM_ADDR + _4MB - 4) == -1)
+		result = FAIL;
+	/* already mapped, and in no region */
+	if(fault_in_page(&pcb, VIRTUAL_MEM_ADDR + 0x48000) != -1 || fault_in_page(&pcb, VIRTUAL_MEM_ADDR + 0x4A000) != -1)
+		result = FAIL;
+	if(!(entries[0x48] & P) || !(entries[0x49] & P) || !(entries[PAGES_NUM - 1] & P) || (entries[0x4A] & P))
+		result = FAIL;
+	if(entries[0x48] & P){
+		page = PHYS_TO_VIRT(entries[0x48] & ~(FRAME_SIZE - 1));
+		for(i = 0; i < ENTRY_SIZE; i++){
+			if(page[i] != (i >= 0x100 && i < 0x140 ? file[i - 0x100] : 0))
+				result = FAIL;
+		}
+	}
+	if(free_user_pages(pcb.user_table) != 3)
+		result = FAIL;
+	frame_free(pcb.user_table, 0);
+	if(frame_free_count() + frame_zeroed_count() != before)
+		result = FAIL;
+	return result;
+}
+
+/* 
+ * int cow_test()
+ * Description: This function shares a scratch process's page with a second one the way
+ *				fork does and checks that both go read-only, that a write fault gives the
+ *				writer its own copy while the other keeps the original, and that the last
+ *				sharer takes the frame over without copying.
+ * Inputs: none
+ * Outputs: none
+ * Return Value: PASS 1/ FAIL 0
+ * Side Effects: none
+ */
+int cow_test(){
+	TEST_HEADER;
+	static pcb_t parent, child;
+	uint32_t* parent_entries;
+	uint32_t* child_entries;
+	uint32_t before, frame, addr = VIRTUAL_MEM_ADDR + _4MB - 4;
+	int result = PASS;
+
+	before = frame_free_count() + frame_zeroed_count();
+	memset(&parent, 0, sizeof(parent));
+	memset(&child, 0, sizeof(child));
+	parent.user_table = frame_alloc(0);
+	child.user_table = frame_alloc(0);
+	if(parent.user_table == 0 || child.user_table == 0)
+		return FAIL;
+	parent_entries = PHYS_TO_VIRT(parent.user_table);
+	child_entries = PHYS_TO_VIRT(child.user_table);
+	memset(parent_entries, 0, FRAME_SIZE);
+	memset(child_entries, 0, FRAME_SIZE);
+	parent.regions[0].start = VIRTUAL_MEM_ADDR + _4MB - ENTRY_SIZE;
+	parent.regions[0].end = VIRTUAL_MEM_ADDR + _4MB;
+	parent.regions[0].type = REGION_STACK;
+	parent.region_count = 1;
+
+	if(fault_in_page(&parent, addr) == -1)
+		return FAIL;
+	frame = parent_entries[PAGES_NUM - 1] & ~(FRAME_SIZE - 1);
+	*(uint32_t*)PHYS_TO_VIRT(frame) = 0x391;
+	share_user_pages(child.user_table, parent.user_table);
+	if(parent_entries[PAGES_NUM - 1] != child_entries[PAGES_NUM - 1] || (parent_entries[PAGES_NUM - 1] & RW)
+		|| !(parent_entries[PAGES_NUM - 1] & COW) || frame_refcount(frame) != 2)
+		result = FAIL;
+
+	/* the child writes: it gets a copy, the parent keeps the frame */
+	if(cow_fault(&child, addr) == -1 || (child_entries[PAGES_NUM - 1] & ~(FRAME_SIZE - 1)) == frame
+		|| !(child_entries[PAGES_NUM - 1] & RW) || frame_refcount(frame) != 1
+		|| *(uint32_t*)PHYS_TO_VIRT(child_entries[PAGES_NUM - 1] & ~(FRAME_SIZE - 1)) != 0x391)
+		result = FAIL;
+	/* then the parent: it is the last one, so no copy */
+	if(cow_fault(&parent, addr) == -1 || parent_entries[PAGES_NUM - 1] != (frame | US | RW | P))
+		result = FAIL;
+	/* a writable page isn't copy-on-write */
+	if(cow_fault(&parent, addr) != -1)
+		result = FAIL;
+
+	free_user_pages(parent.user_table);
+	free_user_pages(child.user_table);
+	frame_free(parent.user_table, 0);
+	frame_free(child.user_table, 0);
+	if(frame_free_count() + frame_zeroed_count() != before)
+		result = FAIL;
+	return result;
+}
+
+/* 
+ * int kmalloc_test()
+ * Description: This function allocates objects of a few sizes, checks their alignment,
+ *				that they don't overlap and that the cache counters follow, then frees
+ *				them and checks the slabs and large allocations went back to the frame
+ *				allocator.
+ * Inputs: none
+ * Outputs: none
+ * Return Value: PASS 1/ FAIL 0
+ * Side Effects: none
+ */
+int kmalloc_test(){
+	TEST_HEADER;
+	static uint8_t* objects[300];
+	uint32_t sizes[4] = {1, 24, 700, KMALLOC_MAX_SIZE + 1};
+	uint32_t before, in_use, i, j;
+	uint8_t* big;
+	int result = PASS;
+
+	before = frame_free_count() + frame_zeroed_count();
+	in_use = kmalloc_caches[1].in_use;
+	if(kmalloc(0) != NULL)
+		result = FAIL;
+	/* 300 32 byte objects need more than one slab */
+	for(i = 0; i < 300; i++){
+		if((objects[i] = kmalloc(sizes[1])) == NULL || ((uint32_t)objects[i] & 0xF) != 0)
+			return FAIL;
+		memset(objects[i], i, sizes[1]);
+	}
+	if(kmalloc_caches[1].in_use != in_use + 300 || kmalloc_caches[1].slabs < 3)
+		result = FAIL;
+	for(i = 0; i < 300; i++){
+		for(j = 0; j < sizes[1]; j++){
+			if(objects[i][j] != (uint8_t)i)
+				result = FAIL;
+		}
+	}
+	for(i = 0; i < 300; i++)
+		kfree(objects[i]);
+	if(kmalloc_caches[1].in_use != in_use)
+		result = FAIL;
+
+	/* one of each size, the last one is a large allocation */
+	for(i = 0; i < 4; i++){
+		if((big = kmalloc(sizes[i])) == NULL)
+			return FAIL;
+		memset(big, 0xA5, sizes[i]);
+		kfree(big);
+	}
+	kfree(NULL);
+
+	/* at most one empty slab stays in each cache touched */
+	if(frame_free_count() + frame_zeroed_count() + 3 < before)
+		result = FAIL;
+	return result;
+}
+
+/* 
+ * int shared_text_test()
+ * Description: This function runs two scratch processes on the same text region of
+ *				hello and checks that the second one maps the frame the first one read,
+ *				read-only, that writing to it is refused, and that the frames go back
+ *				once both processes let go of the text.
+ * Inputs: none
+ * Outputs: none
+ * Return Value: PASS 1/ FAIL 0
+ * Side Effects: none
+ */
+int shared_text_test(){
+	TEST_HEADER;
+	static pcb_t first, second;
+	dentry_t dentry;
+	uint32_t* first_entries;
+	uint32_t* second_entries;
+	uint32_t before, frame, addr = VIRTUAL_MEM_ADDR + 0x48000;
+	int result = PASS;
+
+	if(read_dentry_by_name((uint8_t*)"hello", &dentry) == -1)
+		return FAIL;
+	before = frame_free_count() + frame_zeroed_count();
+	memset(&first, 0, sizeof(first));
+	first.user_table = frame_alloc(0);
+	first.regions[0].start = addr;
+	first.regions[0].end = addr + ENTRY_SIZE;
+	first.regions[0].type = REGION_TEXT;
+	first.regions[0].inode = dentry.inode_num;
+	first.regions[0].vaddr = addr;
+	first.regions[0].offset = 0;
+	first.regions[0].file_end = addr + ENTRY_SIZE;
+	first.region_count = 1;
+	memcpy(&second, &first, sizeof(first));
+	second.user_table = frame_alloc(0);
+	if(first.user_table == 0 || second.user_table == 0)
+		return FAIL;
+	first_entries = PHYS_TO_VIRT(first.user_table);
+	second_entries = PHYS_TO_VIRT(second.user_table);
+	memset(first_entries, 0, FRAME_SIZE);
+	memset(second_entries, 0, FRAME_SIZE);
+	first.text = text_get(dentry.inode_num);
+	second.text = text_get(dentry.inode_num);
+	if(first.text == NULL || first.text != second.text)
+		return FAIL;
+
+	if(fault_in_page(&first, addr) == -1 || fault_in_page(&second, addr + 0x10) == -1)
+		result = FAIL;
+	frame = first_entries[0x48] & ~(FRAME_SIZE - 1);
+	if(second_entries[0x48] != first_entries[0x48] || (first_entries[0x48] & RW) || frame_refcount(frame) != 3)
+		result = FAIL;
+	if(*(uint32_t*)PHYS_TO_VIRT(frame) != 0x464C457F)	// ELF magic
+		result = FAIL;
+	if(cow_fault(&first, addr) != -1)
+		result = FAIL;
+
+	free_user_pages(first.user_table);
+	free_user_pages(second.user_table);
+	frame_free(first.user_table, 0);
+	frame_free(second.user_table, 0);
+	text_put(first.text);
+	if(frame_refcount(frame) != 1)
+		result = FAIL;
+	text_put(second.text);
+	/* the shared_text_t came from kmalloc, whose slab may stay */
+	if(frame_free_count() + frame_zeroed_count() + 1 < before)
+		result = FAIL;
+	return result;
+}
+
+/* 
+ * int text_rewrite_test()
+ * Description: This function copies hello into a new file and runs a scratch process on
+ *				it the way execute does. While it runs, writing or truncating the file has
+ *				to be refused, and a text page it faults in late still has hello's bytes.
+ *				Once it is gone the file can be rewritten, and the next process gets a new
+ *				shared text with the new bytes instead of frames cached for the old ones.
+ * Inputs: none
+ * Outputs: none
+ * Return Value: PASS 1/ FAIL 0
+ * Side Effects: The copy is dropped again by restoring the directory count and rebuilding
+ *				 the name index and free maps
+ */
+#define REWRITE_LEN 0x1800
+int text_rewrite_test(){
+	TEST_HEADER;
+	static pcb_t old_run, new_run;
+	static uint8_t program[REWRITE_LEN];
+	dentry_t dentry;
+	uint8_t* data;
+	uint32_t* old_entries;
+	uint32_t* new_entries;
+	uint32_t dir_count = boot_block->dir_count;
+	uint32_t addr = VIRTUAL_MEM_ADDR + 0x48000;
+	int32_t len, i;
+	int result = PASS;
+
+	if(read_dentry_by_name((uint8_t*)"hello", &dentry) == -1
+		|| (len = read_data(dentry.inode_num, 0, program, REWRITE_LEN)) <= ENTRY_SIZE)
+		return FAIL;
+	if(create_file((uint8_t*)"hello_copy") == -1 || read_dentry_by_name((uint8_t*)"hello_copy", &dentry) == -1
+		|| write_data(dentry.inode_num, 0, program, len) != len)
+		return FAIL;
+
+	memset(&old_run, 0, sizeof(old_run));
+	old_run.regions[0].start = addr;
+	old_run.regions[0].end = addr + 2 * ENTRY_SIZE;
+	old_run.regions[0].type = REGION_TEXT;
+	old_run.regions[0].inode = dentry.inode_num;
+	old_run.regions[0].vaddr = addr;
+	old_run.regions[0].file_end = addr + len;
+	old_run.region_count = 1;
+	memcpy(&new_run, &old_run, sizeof(old_run));
+	old_run.user_table = frame_alloc_zeroed();
+	new_run.user_table = frame_alloc_zeroed();
+	if(old_run.user_table == 0 || new_run.user_table == 0)
+		return FAIL;
+	old_entries = PHYS_TO_VIRT(old_run.user_table);
+	new_entries = PHYS_TO_VIRT(new_run.user_table);
+
+	/* the first run caches its first page, the file can't change under it */
+	inode_exec_retain(dentry.inode_num);
+	old_run.text = text_get(dentry.inode_num);
+	if(old_run.text == NULL || fault_in_page(&old_run, addr) == -1)
+		result = FAIL;
+	if(write_data(dentry.inode_num, 0, (uint8_t*)"new!", 4) != -1 || truncate_data(dentry.inode_num, 0) != -1)
+		result = FAIL;
+
+	/* a page it faults in only now is still the old program */
+	if(fault_in_page(&old_run, addr + ENTRY_SIZE) == -1 || !(old_entries[0x49] & P)){
+		result = FAIL;
+	} else {
+		data = PHYS_TO_VIRT(old_entries[0x49] & ~(FRAME_SIZE - 1));
+		for(i = ENTRY_SIZE; i < len; i++){
+			if(data[i - ENTRY_SIZE] != program[i])
+				result = FAIL;
+		}
+	}
+
+	/* gone, the file can be rewritten and the next run reads the new contents */
+	free_user_pages(old_run.user_table);
+	frame_free(old_run.user_table, 0);
+	text_put(old_run.text);
+	inode_exec_put(dentry.inode_num);
+	if(write_data(dentry.inode_num, 0, (uint8_t*)"new!", 4) != 4)
+		result = FAIL;
+	inode_exec_retain(dentry.inode_num);
+	new_run.text = text_get(dentry.inode_num);
+	if(new_run.text == NULL || fault_in_page(&new_run, addr) == -1 || !(new_entries[0x48] & P))
+		result = FAIL;
+	else if(strncmp((int8_t*)PHYS_TO_VIRT(new_entries[0x48] & ~(FRAME_SIZE - 1)), "new!", 4) != 0)
+		result = FAIL;
+
+	free_user_pages(new_run.user_table);
+	frame_free(new_run.user_table, 0);
+	text_put(new_run.text);
+	inode_exec_put(dentry.inode_num);
+	boot_block->dir_count = dir_count;
+	dentry_hash_init();
+	fs_bitmap_init();
+	return result;
+}
+
+/* 
+ * int heap_test()
+ * Description: This function grows a scratch process's heap, faults a page in past
+ *				the old end, checks the heap can't be moved below its start or into the
+ *				stack, and that shrinking it gives the page back.
+ * Inputs: none
+ * Outputs: none
+ * Return Value: PASS 1/ FAIL 0
+ * Side Effects: none
+ */
+int heap_test(){
+	TEST_HEADER;
+	static pcb_t pcb;
+	uint32_t before, heap = VIRTUAL_MEM_ADDR + 0x4A000;
+	uint32_t* entries;
+	int result = PASS;
+
+	before = frame_free_count() + frame_zeroed_count();
+	memset(&pcb, 0, sizeof(pcb));
+	if((pcb.user_table = frame_alloc(0)) == 0)
+		return FAIL;
+	entries = PHYS_TO_VIRT(pcb.user_table);
+	memset(entries, 0, FRAME_SIZE);
+	pcb.regions[0].start = heap;
+	pcb.regions[0].end = heap;
+	pcb.regions[0].type = REGION_HEAP;
+	pcb.regions[1].start = VIRTUAL_MEM_ADDR + _4MB - 0x100000;
+	pcb.regions[1].end = VIRTUAL_MEM_ADDR + _4MB;
+	pcb.regions[1].type = REGION_STACK;
+	pcb.region_count = 2;
+	pcb.brk = heap;
+
+	/* an empty heap has no pages */
+	if(fault_in_page(&pcb, heap) != -1)
+		result = FAIL;
+	if(set_heap_end(&pcb, heap + 0x1801) == -1 || pcb.brk != heap + 0x1801 || pcb.regions[0].end != heap + 0x2000)
+		result = FAIL;
+	if(fault_in_page(&pcb, heap + 0x1FFF) == -1 || fault_in_page(&pcb, heap + 0x2000) != -1)
+		result = FAIL;
+	if(set_heap_end(&pcb, heap - 1) != -1 || set_heap_end(&pcb, pcb.regions[1].start + 1) != -1)
+		result = FAIL;
+	if(set_heap_end(&pcb, heap + 0x1000) == -1 || (entries[0x4B] & P) || pcb.regions[0].end != heap + 0x1000)
+		result = FAIL;
+
+	frame_free(pcb.user_table, 0);
+	if(frame_free_count() + frame_zeroed_count() != before)
+		result = FAIL;
+	return result;
+}
+
+/* 
+ * int zero_pool_test()
+ * Description: This function dirties a frame, has the idle path clear frames for the
+ *				zeroed pool until it holds some, and checks that frame_alloc_zeroed hands
+ *				out cleared frames from it.
+ * Inputs: none
+ * Outputs: none
+ * Return Value: PASS 1/ FAIL 0
+ * Side Effects: leaves frames in the zeroed pool
+ */
+int zero_pool_test(){
+	TEST_HEADER;
+	uint32_t frame, pooled, i;
+	uint32_t* data;
+	int result = PASS;
+
+	/* a dirty frame freed now is likely to be cleared for the pool next */
+	if((frame = frame_alloc(0)) == 0)
+		return FAIL;
+	memset(PHYS_TO_VIRT(frame), 0xA5, FRAME_SIZE);
+	frame_free(frame, 0);
+
+	for(i = 0; i < 8; i++)
+		frame_zero_idle();
+	if((pooled = frame_zeroed_count()) == 0)
+		return FAIL;
+	for(i = 0; i < pooled; i++){
+		if((frame = frame_alloc_zeroed()) == 0)
+			return FAIL;
+		data = PHYS_TO_VIRT(frame);
+		if(data[0] != 0 || data[FRAME_SIZE / 4 - 1] != 0)
+			result = FAIL;
+		frame_free(frame, 0);
+	}
+	if(frame_zeroed_count() != 0)
+		result = FAIL;
+	return result;
+}
+
+/* 
+ * int swap_test()
+ * Description: This function compresses a heap page of a test process into swap, faults
+ *				it back in and checks its contents, checks that pages that don't compress
+ *				well or are shared stay, and that freeing the window frees its slots.
+ * Inputs: none
+ * Outputs: none
+ * Return Value: PASS 1/ FAIL 0
+ * Side Effects: None
+ */
+int swap_test(){
+	TEST_HEADER;
+	pcb_t pcb;
+	uint32_t before, used, frame, i, seed = 1, page = VIRTUAL_MEM_ADDR + 0x4A000;
+	uint32_t* entries;
+	uint32_t* data;
+	int result = PASS;
+
+	before = frame_free_count() + frame_zeroed_count();
+	used = swap_used_count();
+	memset(&pcb, 0, sizeof(pcb));
+	if((pcb.user_table = frame_alloc_zeroed()) == 0)
+		return FAIL;
+	entries = PHYS_TO_VIRT(pcb.user_table);
+	pcb.regions[0].start = page;
+	pcb.regions[0].end = page + ENTRY_SIZE;
+	pcb.regions[0].type = REGION_HEAP;
+	pcb.region_count = 1;
+	if(fault_in_page(&pcb, page) == -1){
+		frame_free(pcb.user_table, 0);
+		return FAIL;
+	}
+
+	/* small counters compress well, and come back the same */
+	data = PHYS_TO_VIRT(entries[USER_PTE(page)] & ~(ENTRY_SIZE - 1));
+	for(i = 0; i < FRAME_SIZE / 4; i++)
+		data[i] = i % 64;
+	if(swap_out(&entries[USER_PTE(page)]) == -1 || (entries[USER_PTE(page)] & P) || !(entries[USER_PTE(page)] & SWAPPED))
+		result = FAIL;
+	if(swap_used_count() != used + 1)
+		result = FAIL;
+	if(fault_in_page(&pcb, page) == -1 || !(entries[USER_PTE(page)] & RW) || swap_used_count() != used){
+		result = FAIL;
+	} else {
+		data = PHYS_TO_VIRT(entries[USER_PTE(page)] & ~(ENTRY_SIZE - 1));
+		for(i = 0; i < FRAME_SIZE / 4; i++){
+			if(data[i] != i % 64)
+				result = FAIL;
+		}
+	}
+
+	/* random data and shared frames are left alone */
+	if(entries[USER_PTE(page)] & P){
+		for(i = 0; i < FRAME_SIZE / 4; i++)
+			data[i] = seed = seed * 1103515245 + 12345;
+		if(swap_out(&entries[USER_PTE(page)]) != -1)
+			result = FAIL;
+		memset(data, 0, FRAME_SIZE);
+		frame = entries[USER_PTE(page)] & ~(ENTRY_SIZE - 1);
+		frame_share(frame);
+		if(swap_out(&entries[USER_PTE(page)]) != -1)
+			result = FAIL;
+		frame_put(frame);
+		if(swap_out(&entries[USER_PTE(page)]) == -1)
+			result = FAIL;
+	}
+
+	/* the swapped out page goes with the window */
+	free_user_pages(pcb.user_table);
+	frame_free(pcb.user_table, 0);
+	if(swap_used_count() != used)
+		result = FAIL;
+	if(frame_free_count() + frame_zeroed_count() + 1 < before)
+		result = FAIL;
+	return result;
+}
+
 /* =============================== rtc test ====================================== */
 
 /*
@@ -227,8 +810,382 @@ void read_dentry_name_test(char* name){
 
 */
 
+/* 
+ * uint32_t time_dentry_lookup(const int8_t* fname)
+ * Description: Times read_dentry_by_name for one name.
+ * Inputs: const int8_t* fname - name to look up, may not exist
+ * Outputs: none
+ * Return Value: cycles per lookup
+ * Side Effects: None
+ */
+#define LOOKUP_ITERS 1000
+uint32_t time_dentry_lookup(const int8_t* fname){
+	dentry_t found;
+	uint32_t start;
+	int j;
+
+	start = rdtsc_lo();
+	for(j = 0; j < LOOKUP_ITERS; j++)
+		read_dentry_by_name((const uint8_t*)fname, &found);
+	return (rdtsc_lo() - start) / LOOKUP_ITERS;
+}
+
+/* 
+ * void dentry_lookup_bench()
+ * Description: Fills the root directory toward NUM_FILES in steps of LOOKUP_STEP
+ *				files and at each fill level times lookups of the first dentry, the
+ *				newest one and a miss. With the hashed index the cycle counts should
+ *				stay flat as the directory fills instead of growing linearly.
+ * Inputs: none
+ * Outputs: cycles per lookup at each fill level
+ * Side Effects: The bench files are dropped again by restoring the directory count and
+ *				 rebuilding the name index and free maps, so the image is left as it was
+ */
+#define LOOKUP_STEP 8
+void dentry_lookup_bench(){
+	TEST_HEADER;
+	dentry_t dentry;
+	int8_t first[FILENAME_LEN + 1];
+	int8_t last[FILENAME_LEN + 1];
+	int8_t fname[FILENAME_LEN + 1];
+	uint32_t dir_count = boot_block->dir_count;
+	uint32_t count = 0;
+	int i;
+
+	read_dentry_by_index(0, &dentry);
+	strncpy(first, dentry.file_name, FILENAME_LEN);
+	first[FILENAME_LEN] = '\0';
+	read_dentry_by_index(dir_count - 1, &dentry);
+	strncpy(last, dentry.file_name, FILENAME_LEN);
+	last[FILENAME_LEN] = '\0';
+
+	while(1){
+		printf("%d dentries: first %u, last %u, miss %u cycles\n", boot_block->dir_count,
+			time_dentry_lookup(first), time_dentry_lookup(last), time_dentry_lookup("no_such_file"));
+		if(boot_block->dir_count >= NUM_FILES)
+			break;
+		/* grow the directory by a step of empty files named bench_<n> */
+		for(i = 0; i < LOOKUP_STEP && boot_block->dir_count < NUM_FILES; i++){
+			strcpy(fname, "bench_");
+			itoa(count++, fname + 6, 10);
+			if(create_file((uint8_t*)fname) == -1)
+				break;
+			strcpy(last, fname);
+		}
+		if(i == 0){
+			printf("create_file failed, is the image writable?\n");
+			break;
+		}
+	}
+
+	boot_block->dir_count = dir_count;
+	dentry_hash_init();
+	fs_bitmap_init();
+}
+
+/* 
+ * void read_data_bench()
+ * Description: Measures read_data throughput for 4KB, 64KB and whole-file reads
+ *				from the largest regular file in the filesystem.
+ * Inputs: none
+ * Outputs: MB/s for each read size
+ * Side Effects: Reprograms PIT channel 2 to calibrate the timestamp counter
+ */
+#define READ_ITERS 100
+#define READ_BENCH_BUF 0x10000
+uint8_t read_bench_buf[READ_BENCH_BUF];
+void read_data_bench(){
+	TEST_HEADER;
+	dentry_t dentry;
+	inode_t* inode;
+	uint32_t sizes[3] = {ABS_BLOCK_SIZE, READ_BENCH_BUF, 0};
+	uint32_t best_inode = 0, best_len = 0;
+	uint32_t mhz, start, us, nbytes, total;
+	int32_t got;
+	int i, j;
+
+	/* pick the largest regular file to read from */
+	for(i = 0; i < boot_block->dir_count; i++){
+		read_dentry_by_index(i, &dentry);
+		if(dentry.file_type != 2)
+			continue;
+		inode = (inode_t*)(boot_block_end + (dentry.inode_num * ABS_BLOCK_SIZE));
+		if(inode->length > best_len){
+			best_len = inode->length;
+			best_inode = dentry.inode_num;
+		}
+	}
+	printf("reading inode %u, %u bytes\n", best_inode, best_len);
+
+	mhz = tsc_mhz();
+	if(mhz == 0)
+		mhz = 1;
+	sizes[2] = best_len;
+
+	for(i = 0; i < 3; i++){
+		/* a whole-file read bigger than the buffer is done in buffer-sized chunks */
+		total = 0;
+		start = rdtsc_lo();
+		for(j = 0; j < READ_ITERS; j++){
+			uint32_t offset = 0;
+			do {
+				nbytes = sizes[i] - offset;
+				if(nbytes > READ_BENCH_BUF)
+					nbytes = READ_BENCH_BUF;
+				got = read_data(best_inode, offset, read_bench_buf, nbytes);
+				if(got <= 0)
+					break;
+				offset += got;
+				total += got;
+			} while(i == 2 && offset < sizes[i]);
+		}
+		us = (rdtsc_lo() - start) / mhz;
+		if(us == 0)
+			us = 1;
+		/* bytes per microsecond is MB/s */
+		printf("read %u bytes: %u MB/s\n", sizes[i], total / us);
+	}
+}
+
+/* 
+ * int run_read_test()
+ * Description: Reads each regular file in one call, which copies whole runs of datablocks,
+ *				and again in odd-sized chunks that straddle block boundaries, and checks
+ *				both reads agree. Works on block list and extent images alike.
+ * Inputs: none
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ */
+#define RUN_CHUNK 1000
+int run_read_test(){
+	TEST_HEADER;
+	dentry_t dentry;
+	uint8_t chunk[RUN_CHUNK];
+	int32_t length, got, j;
+	uint32_t offset;
+	int i;
+	int result = PASS;
+
+	for(i = 0; read_dentry_by_index(i, &dentry) == 0; i++){
+		if(dentry.file_type != 2)
+			continue;
+		length = get_inode_length(dentry.inode_num);
+		if(length > READ_BENCH_BUF)
+			length = READ_BENCH_BUF;
+		if(read_data(dentry.inode_num, 0, read_bench_buf, length) != length)
+			result = FAIL;
+		for(offset = 0; offset < length; offset += got){
+			got = read_data(dentry.inode_num, offset, chunk, RUN_CHUNK);
+			if(got <= 0){
+				result = FAIL;
+				break;
+			}
+			for(j = 0; j < got && offset + j < length; j++) {
+				if(chunk[j] != read_bench_buf[offset + j])
+					result = FAIL;
+			}
+		}
+	}
+
+	return result;
+}
+
+/* 
+ * int write_data_test()
+ * Description: Creates a file, writes two blocks' worth into it, appends, reads it back,
+ *				then truncates it down and back up and checks the regrown tail reads as zero.
+ * Inputs: none
+ * Outputs: PASS/FAIL
+ * Side Effects: Leaves write_test.txt in the (in-memory) filesystem
+ */
+int write_data_test(){
+	TEST_HEADER;
+	dentry_t dentry;
+	uint32_t i;
+	int result = PASS;
+
+	if(create_file((uint8_t*)"write_test.txt") == -1 || read_dentry_by_name((uint8_t*)"write_test.txt", &dentry) == -1)
+		return FAIL;
+
+	for(i = 0; i < 2 * ABS_BLOCK_SIZE; i++)
+		read_bench_buf[i] = (uint8_t)i;
+	if(write_data(dentry.inode_num, 0, read_bench_buf, 2 * ABS_BLOCK_SIZE) != 2 * ABS_BLOCK_SIZE)
+		result = FAIL;
+	/* append across the block boundary */
+	if(write_data(dentry.inode_num, 2 * ABS_BLOCK_SIZE, read_bench_buf, 100) != 100)
+		result = FAIL;
+	if(get_inode_length(dentry.inode_num) != 2 * ABS_BLOCK_SIZE + 100)
+		result = FAIL;
+
+	memset(read_bench_buf, 0, 2 * ABS_BLOCK_SIZE + 100);
+	if(read_data(dentry.inode_num, 0, read_bench_buf, 2 * ABS_BLOCK_SIZE + 100) != 2 * ABS_BLOCK_SIZE + 100)
+		result = FAIL;
+	for(i = 0; i < 2 * ABS_BLOCK_SIZE + 100; i++) {
+		if(read_bench_buf[i] != (uint8_t)(i % (2 * ABS_BLOCK_SIZE)))
+			result = FAIL;
+	}
+
+	/* shrink into the first block, then grow again: the regrown part must be zero */
+	if(truncate_data(dentry.inode_num, 10) == -1 || truncate_data(dentry.inode_num, ABS_BLOCK_SIZE + 10) == -1)
+		result = FAIL;
+	if(read_data(dentry.inode_num, 0, read_bench_buf, ABS_BLOCK_SIZE + 10) != ABS_BLOCK_SIZE + 10)
+		result = FAIL;
+	for(i = 10; i < ABS_BLOCK_SIZE + 10; i++) {
+		if(read_bench_buf[i] != 0)
+			result = FAIL;
+	}
+
+	return result;
+}
+
+/* 
+ * int tmpfs_test()
+ * Description: Creates a tmp/ file, writes three pages into it and reads them back, then
+ *				unlinks it while still open and checks its pages only go back to the pool
+ *				once it is released.
+ * Inputs: none
+ * Outputs: PASS/FAIL
+ * Side Effects: None once it passes, the pool is left as it was found
+ */
+int tmpfs_test(){
+	TEST_HEADER;
+	tmpfs_inode_t* inode;
+	stat_t st;
+	uint32_t i, free_pages;
+	int32_t file;
+	int result = PASS;
+
+	if(tmpfs_create((uint8_t*)"tmp/scratch") == -1 || tmpfs_create((uint8_t*)"tmp/scratch") == 0)
+		return FAIL;
+	/* only names directly in tmp/ are tmpfs names */
+	if(tmpfs_create((uint8_t*)"tmp/a/b") == 0 || tmpfs_name((uint8_t*)"tmpfile") != NULL)
+		result = FAIL;
+	if((file = tmpfs_open((uint8_t*)"/tmp/scratch")) == -1)
+		return FAIL;
+	inode = (tmpfs_inode_t*)file;
+	/* the inode came from a slab, so the file costs no pages until it is written */
+	free_pages = page_pool_free_count();
+
+	for(i = 0; i < 3 * POOL_PAGE_SIZE; i++)
+		read_bench_buf[i] = (uint8_t)(i * 7);
+	if(tmpfs_write_data(inode, 0, read_bench_buf, 3 * POOL_PAGE_SIZE) != 3 * POOL_PAGE_SIZE)
+		result = FAIL;
+	/* three data pages and the page of pointers */
+	if(page_pool_free_count() != free_pages - 4)
+		result = FAIL;
+	if(tmpfs_stat((uint8_t*)"tmp/scratch", &st) == -1 || st.length != 3 * POOL_PAGE_SIZE)
+		result = FAIL;
+
+	memset(read_bench_buf, 0, 3 * POOL_PAGE_SIZE);
+	if(tmpfs_read_data(inode, 0, read_bench_buf, 4 * POOL_PAGE_SIZE) != 3 * POOL_PAGE_SIZE)
+		result = FAIL;
+	for(i = 0; i < 3 * POOL_PAGE_SIZE; i++) {
+		if(read_bench_buf[i] != (uint8_t)(i * 7))
+			result = FAIL;
+	}
+
+	/* unlinked but still open: the name is gone, the pages are not */
+	if(tmpfs_unlink((uint8_t*)"tmp/scratch") == -1 || tmpfs_stat((uint8_t*)"tmp/scratch", &st) == 0)
+		result = FAIL;
+	if(page_pool_free_count() != free_pages - 4)
+		result = FAIL;
+	tmpfs_release(file);
+	if(page_pool_free_count() != free_pages)
+		result = FAIL;
+
+	return result;
+}
+
 /* ====================== rtc tests for cp2 ============================== */
 
+/* 
+ * int frame_test()
+ * Description: Allocates a block of each size the kernel uses, checks each is aligned to
+ *				its size, above the kernel and usable through the physical memory mapping,
+ *				then frees them and checks the free count comes back.
+ * Inputs: none
+ * Outputs: PASS/FAIL
+ * Side Effects: None once it passes, the free lists are left as they were found
+ */
+int frame_test(){
+	TEST_HEADER;
+	uint32_t orders[3] = {0, FRAME_ORDER_8KB, FRAME_ORDER_4MB};
+	uint32_t blocks[3];
+	uint32_t i, size, free_frames = frame_free_count();
+	uint8_t* mem;
+	int result = PASS;
+
+	if(free_frames == 0)
+		return FAIL;
+	for(i = 0; i < 3; i++) {
+		size = FRAME_SIZE << orders[i];
+		blocks[i] = frame_alloc(orders[i]);
+		if(blocks[i] < FRAME_FIRST || (blocks[i] & (size - 1)) != 0) {
+			result = FAIL;
+			continue;
+		}
+		/* first and last byte of the block */
+		mem = PHYS_TO_VIRT(blocks[i]);
+		mem[0] = 0x39;
+		mem[size - 1] = 0x1;
+		if(mem[0] != 0x39 || mem[size - 1] != 0x1)
+			result = FAIL;
+	}
+	if(frame_free_count() != free_frames - 1 - 2 - 1024)
+		result = FAIL;
+	for(i = 0; i < 3; i++)
+		frame_free(blocks[i], orders[i]);
+	if(frame_free_count() != free_frames)
+		result = FAIL;
+
+	return result;
+}
+
+/*
+ * int path_walk_test()
+ * Description: Resolves plain names, '/' separated paths and paths that must fail.
+ *				Works on any image; subdirectories are only exercised when the image
+ *				was built from a nested fsdir.
+ * Inputs: none
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ */
+int path_walk_test(){
+	TEST_HEADER;
+	dentry_t dentry, dir_dentry;
+	uint8_t path[PATH_LEN + 1];
+	uint32_t i;
+	int result = PASS;
+
+	if(read_dentry_by_name((uint8_t*)"frame0.txt", &dentry) == -1 || dentry.file_type != 2)
+		result = FAIL;
+	/* leading and repeated slashes are ignored */
+	if(read_dentry_by_name((uint8_t*)"//frame0.txt", &dentry) == -1)
+		result = FAIL;
+	/* a regular file can't be walked through, an empty path names nothing */
+	if(read_dentry_by_name((uint8_t*)"frame0.txt/x", &dentry) == 0 || read_dentry_by_name((uint8_t*)"/", &dentry) == 0)
+		result = FAIL;
+
+	/* every entry of every root subdirectory must resolve by its full path */
+	for(i = 0; read_dentry_by_index(i, &dir_dentry) == 0; i++){
+		uint32_t j;
+		if(!dentry_is_dir(&dir_dentry))
+			continue;
+		for(j = 0; read_dentry_in_dir(dir_dentry.inode_num, j, &dentry) == 0; j++){
+			uint32_t len = strlen(dir_dentry.file_name) < FILENAME_LEN ? strlen(dir_dentry.file_name) : FILENAME_LEN;
+			memcpy(path, dir_dentry.file_name, len);
+			path[len] = '/';
+			strncpy((int8_t*)path + len + 1, dentry.file_name, FILENAME_LEN);
+			path[len + 1 + FILENAME_LEN] = '\0';
+			/* twice, the second lookup comes from the dentry cache */
+			if(read_dentry_by_name(path, &dentry) == -1 || read_dentry_by_name(path, &dentry) == -1)
+				result = FAIL;
+		}
+	}
+
+	return result;
+}
+
 /*
  * int rtc_open_test()
  * open the rtc and set frequency to 2 Hz
@@ -375,6 +1332,15 @@ void launch_tests(){
 	//PF_test();
 	//TEST_OUTPUT("vidmem PF test", VM_paging_test());
 	//TEST_OUTPUT("kernel PF test", KM_paging_test());
+	//TEST_OUTPUT("global_page_test", global_page_test());
+	//TEST_OUTPUT("demand_page_test", demand_page_test());
+	//TEST_OUTPUT("cow_test", cow_test());
+	//TEST_OUTPUT("kmalloc_test", kmalloc_test());
+	//TEST_OUTPUT("shared_text_test", shared_text_test());
+	//TEST_OUTPUT("text_rewrite_test", text_rewrite_test());
+	//TEST_OUTPUT("heap_test", heap_test());
+	//TEST_OUTPUT("zero_pool_test", zero_pool_test());
+	//TEST_OUTPUT("swap_test", swap_test());
 
 	/* cp2 tests */	
 	//terminal_test1();
@@ -383,6 +1349,13 @@ void launch_tests(){
 	//read_file_test(10, 187);
 	//TEST_OUTPUT("read_data_test", read_data_test());
 	//read_dentry_name_test();
+	//dentry_lookup_bench();
+	//read_data_bench();
+	//TEST_OUTPUT("run_read_test", run_read_test());
+	//TEST_OUTPUT("write_data_test", write_data_test());
+	//TEST_OUTPUT("path_walk_test", path_walk_test());
+	//TEST_OUTPUT("tmpfs_test", tmpfs_test());
+	//TEST_OUTPUT("frame_test", frame_test());
 	//TEST_OUTPUT("rtc_open_test", rtc_open_test());
 	//TEST_OUTPUT("rtc_write_test", rtc_write_test());
 	//rtc_combined_test();
@@ -0,0 +1,144 @@
+/* text.c - shares the read-only pages of a program between its processes
+ *
+ * Every program being run has a shared_text_t holding the frames of the
+ * text pages its processes have faulted in so far, by user page. The first
+ * process to touch a text page reads it from the file, the others map the
+ * same frame read-only. The table holds a reference on each of its frames,
+ * so they stay around while any process runs the program, and are given
+ * back with its last process.
+ *
+ * While a text exists its file can't be written or truncated, so pages
+ * faulted in late match the ones read early. A text also remembers the
+ * file's generation, so once the file changes after its last process is
+ * gone, or its inode is reused, the next process gets a fresh text.
+ */
+
+#include "text.h"
+#include "kmalloc.h"
+#include "frame.h"
+#include "paging.h"
+#include "lib.h"
+#include "filesys.h"
+
+/* programs some process is running */
+shared_text_t* shared_texts = NULL;
+
+/*
+ * shared_text_t* text_get(uint32_t inode)
+ * Inputs: uint32_t inode - program a new process runs
+ * Outputs: None
+ * Return Value: the program's shared text with the process counted, NULL if there is
+ *				 no memory for it (the process's text is then private). Text read before
+ *				 the file last changed isn't reused.
+ * Side Effects: A new text keeps its file from being written until it is put back
+ */
+shared_text_t* text_get(uint32_t inode)
+{
+	shared_text_t* text;
+	uint32_t generation = get_inode_generation(inode);
+	uint32_t flags;
+
+	cli_and_save(flags);
+	for(text = shared_texts; text != NULL && (text->inode != inode || text->generation != generation); text = text->next);
+	if(text != NULL){
+		text->refs++;
+		restore_flags(flags);
+		return text;
+	}
+	if((text = kmalloc(sizeof(shared_text_t))) == NULL){
+		restore_flags(flags);
+		return NULL;
+	}
+	if((text->pages = frame_alloc_zeroed()) == 0){
+		kfree(text);
+		restore_flags(flags);
+		return NULL;
+	}
+	text->inode = inode;
+	text->generation = generation;
+	text->refs = 1;
+	inode_exec_retain(inode);
+	text->next = shared_texts;
+	shared_texts = text;
+	restore_flags(flags);
+	return text;
+}
+
+/*
+ * void text_retain(shared_text_t* text)
+ * Inputs: shared_text_t* text - text a forked process shares with its parent, or NULL
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void text_retain(shared_text_t* text)
+{
+	uint32_t flags;
+
+	if(text == NULL)
+		return;
+	cli_and_save(flags);
+	text->refs++;
+	restore_flags(flags);
+}
+
+/*
+ * void text_put(shared_text_t* text)
+ * Description: drops a halting process from its program's text, the last one gives
+ *				the text frames and the table back
+ * Inputs: shared_text_t* text - from text_get, or NULL
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void text_put(shared_text_t* text)
+{
+	shared_text_t** link;
+	uint32_t* frames;
+	uint32_t flags, i;
+
+	if(text == NULL)
+		return;
+	cli_and_save(flags);
+	if(--text->refs == 0){
+		for(link = &shared_texts; *link != text; link = &(*link)->next);
+		*link = text->next;
+		frames = PHYS_TO_VIRT(text->pages);
+		for(i = 0; i < PAGES_NUM; i++){
+			if(frames[i] != 0)
+				frame_put(frames[i]);
+		}
+		frame_free(text->pages, 0);
+		inode_exec_put(text->inode);
+		kfree(text);
+	}
+	restore_flags(flags);
+}
+
+/*
+ * uint32_t text_frame(shared_text_t* text, uint32_t page)
+ * Inputs: shared_text_t* text - program's text
+ * 		   uint32_t page - user address of a text page
+ * Outputs: None
+ * Return Value: the frame holding the page, 0 if no process has read it yet
+ * Side Effects: None
+ */
+uint32_t text_frame(shared_text_t* text, uint32_t page)
+{
+	return ((uint32_t*)PHYS_TO_VIRT(text->pages))[USER_PTE(page)];
+}
+
+/*
+ * void text_add_frame(shared_text_t* text, uint32_t page, uint32_t frame)
+ * Inputs: shared_text_t* text - program's text
+ * 		   uint32_t page - user address of a text page no process has read yet
+ * 		   uint32_t frame - frame just filled with it
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: The table takes a reference on the frame
+ */
+void text_add_frame(shared_text_t* text, uint32_t page, uint32_t frame)
+{
+	frame_share(frame);
+	((uint32_t*)PHYS_TO_VIRT(text->pages))[USER_PTE(page)] = frame;
+}
@@ -0,0 +1,27 @@
+/* text.h - Program text pages shared by every process running the same file */
+
+#ifndef _TEXT_H
+#define _TEXT_H
+
+#include "types.h"
+
+#ifndef ASM
+
+/* Text of one program, kept while any process runs it */
+typedef struct shared_text {
+	uint32_t inode;					/* program file */
+	uint32_t generation;			/* get_inode_generation of the file when the text was made */
+	uint32_t refs;					/* processes running it */
+	uint32_t pages;					/* physical addr of its frames by user page (USER_PTE), 0 where not read yet */
+	struct shared_text* next;		/* next program with shared text */
+} shared_text_t;
+
+shared_text_t* text_get(uint32_t inode);
+void text_retain(shared_text_t* text);
+void text_put(shared_text_t* text);
+uint32_t text_frame(shared_text_t* text, uint32_t page);
+void text_add_frame(shared_text_t* text, uint32_t page, uint32_t frame);
+
+#endif /* ASM */
+
+#endif /* _TEXT_H */
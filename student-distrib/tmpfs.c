@@ -0,0 +1,575 @@
+/* tmpfs.c - scratch files kept in kernel memory, named tmp/<name>
+ *
+ * tmp/ is a single flat directory that open, create, stat and unlink look
+ * at before the filesystem image, so it shadows anything called tmp there.
+ * Inodes come from kmalloc. A file's data is in pool pages found through one
+ * pool page of pointers, so files hold up to TMPFS_MAX_FILE_LEN bytes. Pages
+ * past the end of a file are freed when it shrinks, and all of them go back
+ * to the pool when the file is unlinked and no fd has it open.
+ */
+
+#include "tmpfs.h"
+#include "lib.h"
+#include "syscall.h"
+#include "kmalloc.h"
+
+/* number of data pages a file of the given length spans */
+#define TMPFS_PAGES(length) (((length) + POOL_PAGE_SIZE - 1) / POOL_PAGE_SIZE)
+
+/* files in tmp/, most recently created first */
+tmpfs_inode_t* tmpfs_files = NULL;
+
+/*
+ * const uint8_t* tmpfs_name(const uint8_t* filename)
+ * Inputs: const uint8_t* filename - path as passed to open, create, stat or unlink
+ * Outputs: None
+ * Return Value: the name within tmp/ ("" for tmp itself), NULL if the path isn't in the tmpfs
+ * Side Effects: None
+ */
+const uint8_t* tmpfs_name(const uint8_t* filename)
+{
+	while(*filename == '/')
+		filename++;
+	if(strncmp((int8_t*)filename, TMPFS_PREFIX, TMPFS_PREFIX_LEN) != 0)
+		return NULL;
+	filename += TMPFS_PREFIX_LEN;
+	/* "tmpfile" is a name in the image, not in tmp/ */
+	if(*filename != '/' && *filename != '\0')
+		return NULL;
+	while(*filename == '/')
+		filename++;
+	return filename;
+}
+
+/*
+ * tmpfs_inode_t* tmpfs_inode_alloc()
+ * Inputs: None
+ * Outputs: None
+ * Return Value: a zeroed inode, NULL if the kernel heap is out of memory
+ * Side Effects: None
+ */
+static tmpfs_inode_t* tmpfs_inode_alloc()
+{
+	tmpfs_inode_t* inode;
+
+	if((inode = kmalloc(sizeof(tmpfs_inode_t))) != NULL)
+		memset(inode, 0, sizeof(tmpfs_inode_t));
+	return inode;
+}
+
+/*
+ * void tmpfs_free_pages(tmpfs_inode_t* inode, uint32_t first)
+ * Inputs: tmpfs_inode_t* inode - file to shrink
+ * 		   uint32_t first - first data page to give back
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Returns the data pages from first on to the pool, and the page of
+ *				 pointers too once no data page is left
+ */
+static void tmpfs_free_pages(tmpfs_inode_t* inode, uint32_t first)
+{
+	uint32_t page;
+
+	if(inode->pages == NULL)
+		return;
+	for(page = first; page < TMPFS_FILE_PAGES; page++){
+		page_free(inode->pages[page]);
+		inode->pages[page] = NULL;
+	}
+	if(first == 0){
+		page_free(inode->pages);
+		inode->pages = NULL;
+	}
+}
+
+/*
+ * void tmpfs_inode_free(tmpfs_inode_t* inode)
+ * Inputs: tmpfs_inode_t* inode - unlinked file no fd has open
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Gives the file's pages back to the pool and the inode back to the kernel heap
+ */
+static void tmpfs_inode_free(tmpfs_inode_t* inode)
+{
+	tmpfs_free_pages(inode, 0);
+	kfree(inode);
+}
+
+/*
+ * tmpfs_inode_t* tmpfs_lookup(const uint8_t* name)
+ * Inputs: const uint8_t* name - name within tmp/
+ * Outputs: None
+ * Return Value: the file, NULL if there is none by that name
+ * Side Effects: None
+ */
+static tmpfs_inode_t* tmpfs_lookup(const uint8_t* name)
+{
+	tmpfs_inode_t* inode;
+
+	if(strlen((int8_t*)name) > FILENAME_LEN)
+		return NULL;
+	for(inode = tmpfs_files; inode != NULL; inode = inode->next){
+		if(strncmp(inode->file_name, (int8_t*)name, FILENAME_LEN) == 0)
+			return inode;
+	}
+	return NULL;
+}
+
+/*
+ * int32_t tmpfs_create(const uint8_t* filename)
+ * Inputs: const uint8_t* filename - tmp/<name>
+ * Outputs: None
+ * Return Value: 0 (success), -1 (bad or taken name, or the pool is empty)
+ * Side Effects: Adds an empty file to tmp/
+ */
+int32_t tmpfs_create(const uint8_t* filename)
+{
+	const uint8_t* name = tmpfs_name(filename);
+	tmpfs_inode_t* inode;
+	uint32_t len, i, flags;
+
+	if(name == NULL)
+		return -1;
+	len = strlen((int8_t*)name);
+	if(len == 0 || len > FILENAME_LEN)
+		return -1;
+	/* tmp/ has no subdirectories */
+	for(i = 0; i < len; i++){
+		if(name[i] == '/')
+			return -1;
+	}
+
+	cli_and_save(flags);
+	if(tmpfs_lookup(name) != NULL || (inode = tmpfs_inode_alloc()) == NULL){
+		restore_flags(flags);
+		return -1;
+	}
+	strncpy(inode->file_name, (int8_t*)name, FILENAME_LEN);
+	inode->next = tmpfs_files;
+	tmpfs_files = inode;
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+ * int32_t tmpfs_unlink(const uint8_t* filename)
+ * Inputs: const uint8_t* filename - tmp/<name>
+ * Outputs: None
+ * Return Value: 0 (success), -1 if there is no such file
+ * Side Effects: Removes the name from tmp/. The file's memory is freed now, or at the
+ *				 last close if an fd still has it open.
+ */
+int32_t tmpfs_unlink(const uint8_t* filename)
+{
+	const uint8_t* name = tmpfs_name(filename);
+	tmpfs_inode_t** link;
+	tmpfs_inode_t* inode;
+	uint32_t flags;
+
+	if(name == NULL || strlen((int8_t*)name) > FILENAME_LEN)
+		return -1;
+
+	cli_and_save(flags);
+	for(link = &tmpfs_files; (inode = *link) != NULL; link = &inode->next){
+		if(strncmp(inode->file_name, (int8_t*)name, FILENAME_LEN) == 0)
+			break;
+	}
+	if(inode == NULL){
+		restore_flags(flags);
+		return -1;
+	}
+	*link = inode->next;
+	inode->unlinked = 1;
+	if(inode->open_count == 0)
+		tmpfs_inode_free(inode);
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+ * int32_t tmpfs_stat(const uint8_t* filename, stat_t* st)
+ * Inputs: const uint8_t* filename - tmp or tmp/<name>
+ * 		   stat_t* st - struct to fill in
+ * Outputs: None
+ * Return Value: 0 (success), -1 if there is no such file
+ * Side Effects: None
+ */
+int32_t tmpfs_stat(const uint8_t* filename, stat_t* st)
+{
+	const uint8_t* name = tmpfs_name(filename);
+	tmpfs_inode_t* inode;
+
+	if(name == NULL)
+		return -1;
+	st->inode_num = 0;
+	st->length = 0;
+	if(*name == '\0'){
+		st->file_type = 1;
+		return 0;
+	}
+	if((inode = tmpfs_lookup(name)) == NULL)
+		return -1;
+	/* tmpfs files have no inode number in the image */
+	st->file_type = 2;
+	st->length = inode->length;
+	return 0;
+}
+
+/*
+ * void tmpfs_fstat(int32_t fd, stat_t* st)
+ * Inputs: int32_t fd - file descriptor of an open tmpfs file or of tmp/
+ * 		   stat_t* st - struct to fill in
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: None
+ */
+void tmpfs_fstat(int32_t fd, stat_t* st)
+{
+	pcb_t* cur_process = get_pcb_address();
+	tmpfs_inode_t* inode = (tmpfs_inode_t*)cur_process->file[fd].inode;
+
+	st->inode_num = 0;
+	st->file_type = inode == TMPFS_ROOT ? 1 : 2;
+	st->length = inode == TMPFS_ROOT ? 0 : inode->length;
+}
+
+/*
+ * int32_t tmpfs_open(const uint8_t* filename)
+ * Inputs: const uint8_t* filename - tmp or tmp/<name>
+ * Outputs: None
+ * Return Value: what goes in the fd's inode field, the file's inode or TMPFS_ROOT for
+ *				 tmp/ itself, -1 if there is no such file
+ * Side Effects: Counts the fd as having the file open
+ */
+int32_t tmpfs_open(const uint8_t* filename)
+{
+	const uint8_t* name = tmpfs_name(filename);
+	tmpfs_inode_t* inode;
+	uint32_t flags;
+
+	if(name == NULL)
+		return -1;
+	if(*name == '\0')
+		return TMPFS_ROOT;
+	cli_and_save(flags);
+	if((inode = tmpfs_lookup(name)) != NULL)
+		inode->open_count++;
+	restore_flags(flags);
+	return inode == NULL ? -1 : (int32_t)inode;
+}
+
+/*
+ * void tmpfs_retain(int32_t file)
+ * Inputs: int32_t file - what tmpfs_open returned
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Counts one more fd having the file open, for a copy of an open fd (fork)
+ */
+void tmpfs_retain(int32_t file)
+{
+	uint32_t flags;
+
+	if(file == TMPFS_ROOT)
+		return;
+	cli_and_save(flags);
+	((tmpfs_inode_t*)file)->open_count++;
+	restore_flags(flags);
+}
+
+/*
+ * void tmpfs_release(int32_t file)
+ * Inputs: int32_t file - what tmpfs_open returned
+ * Outputs: None
+ * Return Value: None
+ * Side Effects: Frees an unlinked file once the last open of it is released
+ */
+void tmpfs_release(int32_t file)
+{
+	tmpfs_inode_t* inode = (tmpfs_inode_t*)file;
+	uint32_t flags;
+
+	if(file == TMPFS_ROOT)
+		return;
+	cli_and_save(flags);
+	if(--inode->open_count == 0 && inode->unlinked)
+		tmpfs_inode_free(inode);
+	restore_flags(flags);
+}
+
+/*
+ * int32_t tmpfs_close(int32_t fd)
+ * Inputs: int32_t fd - file descriptor of an open tmpfs file or of tmp/
+ * Outputs: None
+ * Return Value: 0
+ * Side Effects: Frees an unlinked file once its last fd is closed
+ */
+int32_t tmpfs_close(int32_t fd)
+{
+	pcb_t* cur_process = get_pcb_address();
+
+	tmpfs_release(cur_process->file[fd].inode);
+	return 0;
+}
+
+/*
+ * int32_t tmpfs_read_data(tmpfs_inode_t* inode, uint32_t offset, uint8_t* buf, uint32_t length)
+ * Inputs: tmpfs_inode_t* inode - file to read
+ * 		   uint32_t offset - where to start reading
+ * 		   uint8_t* buf - buffer to read into
+ * 		   uint32_t length - bytes wanted
+ * Outputs: None
+ * Return Value: bytes read, 0 at or past the end of the file
+ * Side Effects: None, pages never written (left by growing ftruncate) read as zeroes
+ */
+int32_t tmpfs_read_data(tmpfs_inode_t* inode, uint32_t offset, uint8_t* buf, uint32_t length)
+{
+	uint32_t page, byte_offset, span, bytes_read = 0;
+
+	if(offset >= inode->length)
+		return 0;
+	if(length > inode->length - offset)
+		length = inode->length - offset;
+	page = offset / POOL_PAGE_SIZE;
+	byte_offset = offset % POOL_PAGE_SIZE;
+	while(bytes_read < length){
+		span = POOL_PAGE_SIZE - byte_offset;
+		if(span > length - bytes_read)
+			span = length - bytes_read;
+		if(inode->pages == NULL || inode->pages[page] == NULL)
+			memset(buf + bytes_read, 0, span);
+		else
+			memcpy(buf + bytes_read, inode->pages[page] + byte_offset, span);
+		bytes_read += span;
+		page++;
+		byte_offset = 0;
+	}
+	return bytes_read;
+}
+
+/*
+ * int32_t tmpfs_write_data(tmpfs_inode_t* inode, uint32_t offset, const uint8_t* buf, uint32_t length)
+ * Inputs: tmpfs_inode_t* inode - file to write
+ * 		   uint32_t offset - where to start writing, at most the length of the file
+ * 		   const uint8_t* buf - data to write
+ * 		   uint32_t length - bytes to write
+ * Outputs: None
+ * Return Value: bytes written, -1 if nothing could be written
+ * Side Effects: Takes pages from the pool for the parts of the file that have none
+ */
+int32_t tmpfs_write_data(tmpfs_inode_t* inode, uint32_t offset, const uint8_t* buf, uint32_t length)
+{
+	uint32_t page, byte_offset, span, bytes_written = 0, flags;
+
+	if(offset > inode->length || offset >= TMPFS_MAX_FILE_LEN)
+		return -1;
+	if(length > TMPFS_MAX_FILE_LEN - offset)
+		length = TMPFS_MAX_FILE_LEN - offset;
+
+	cli_and_save(flags);
+	page = offset / POOL_PAGE_SIZE;
+	byte_offset = offset % POOL_PAGE_SIZE;
+	while(bytes_written < length){
+		if(inode->pages == NULL && (inode->pages = page_alloc()) == NULL)
+			break;
+		if(inode->pages[page] == NULL && (inode->pages[page] = page_alloc()) == NULL)
+			break;
+		span = POOL_PAGE_SIZE - byte_offset;
+		if(span > length - bytes_written)
+			span = length - bytes_written;
+		memcpy(inode->pages[page] + byte_offset, buf + bytes_written, span);
+		bytes_written += span;
+		if(offset + bytes_written > inode->length)
+			inode->length = offset + bytes_written;
+		page++;
+		byte_offset = 0;
+	}
+	restore_flags(flags);
+
+	if(bytes_written == 0 && length != 0)
+		return -1;
+	return bytes_written;
+}
+
+/*
+ * int32_t tmpfs_read(int32_t fd, void* buf, int32_t nbytes)
+ * Inputs: int32_t fd - file descriptor of an open tmpfs file
+ * 		   void* buf - buffer to read into
+ * 		   int32_t nbytes - bytes wanted
+ * Outputs: None
+ * Return Value: bytes read, 0 at the end of the file
+ * Side Effects: Advances the fd position
+ */
+int32_t tmpfs_read(int32_t fd, void* buf, int32_t nbytes)
+{
+	pcb_t* cur_process = get_pcb_address();
+	int32_t nbytes_read;
+
+	nbytes_read = tmpfs_read_data((tmpfs_inode_t*)cur_process->file[fd].inode, cur_process->file[fd].pos, buf, nbytes);
+	cur_process->file[fd].pos += nbytes_read;
+	return nbytes_read;
+}
+
+/*
+ * int32_t tmpfs_write(int32_t fd, const void* buf, int32_t nbytes)
+ * Inputs: int32_t fd - file descriptor of an open tmpfs file
+ * 		   const void* buf - data to write
+ * 		   int32_t nbytes - bytes to write
+ * Outputs: None
+ * Return Value: bytes written, -1 if the pool is empty or the file is full
+ * Side Effects: Writes at the fd position, growing the file past its end, and advances
+ *				 the position
+ */
+int32_t tmpfs_write(int32_t fd, const void* buf, int32_t nbytes)
+{
+	pcb_t* cur_process = get_pcb_address();
+	int32_t nbytes_written;
+
+	nbytes_written = tmpfs_write_data((tmpfs_inode_t*)cur_process->file[fd].inode, cur_process->file[fd].pos, buf, nbytes);
+	if(nbytes_written == -1)
+		return -1;
+	cur_process->file[fd].pos += nbytes_written;
+	return nbytes_written;
+}
+
+/*
+ * int32_t tmpfs_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset)
+ * Inputs: int32_t fd - file descriptor of an open tmpfs file
+ * 		   void* buf - buffer to read into
+ * 		   int32_t nbytes - bytes wanted
+ * 		   uint32_t offset - file offset to read from
+ * Outputs: None
+ * Return Value: bytes read
+ * Side Effects: None, the fd position is left where it was
+ */
+int32_t tmpfs_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset)
+{
+	pcb_t* cur_process = get_pcb_address();
+
+	return tmpfs_read_data((tmpfs_inode_t*)cur_process->file[fd].inode, offset, buf, nbytes);
+}
+
+/*
+ * int32_t tmpfs_lseek(int32_t fd, int32_t offset, int32_t whence)
+ * Inputs: int32_t fd - file descriptor of an open tmpfs file
+ * 		   int32_t offset - offset relative to whence
+ * 		   int32_t whence - SEEK_SET, SEEK_CUR or SEEK_END
+ * Outputs: None
+ * Return Value: new position, -1 if it would land outside the file
+ * Side Effects: Moves the fd position
+ */
+int32_t tmpfs_lseek(int32_t fd, int32_t offset, int32_t whence)
+{
+	pcb_t* cur_process = get_pcb_address();
+	tmpfs_inode_t* inode = (tmpfs_inode_t*)cur_process->file[fd].inode;
+	int32_t pos;
+
+	pos = seek_position(cur_process->file[fd].pos, inode->length, offset, whence);
+	if(pos == -1)
+		return -1;
+	cur_process->file[fd].pos = pos;
+	return pos;
+}
+
+/*
+ * int32_t tmpfs_truncate(int32_t fd, int32_t length)
+ * Inputs: int32_t fd - file descriptor of an open tmpfs file
+ * 		   int32_t length - new length of the file
+ * Outputs: None
+ * Return Value: 0 (success), -1 (bad length)
+ * Side Effects: Shrinking gives the pages past the new end back to the pool, growing
+ *				 adds zeroes without taking any pages
+ */
+int32_t tmpfs_truncate(int32_t fd, int32_t length)
+{
+	pcb_t* cur_process = get_pcb_address();
+	tmpfs_inode_t* inode = (tmpfs_inode_t*)cur_process->file[fd].inode;
+	uint8_t* last_page;
+	uint32_t flags;
+
+	if(length < 0 || length > TMPFS_MAX_FILE_LEN)
+		return -1;
+
+	cli_and_save(flags);
+	if(length < inode->length){
+		tmpfs_free_pages(inode, TMPFS_PAGES(length));
+		/* the rest of the last page has to read as zeroes if the file grows again */
+		if(inode->pages != NULL && length % POOL_PAGE_SIZE != 0
+			&& (last_page = inode->pages[length / POOL_PAGE_SIZE]) != NULL)
+			memset(last_page + length % POOL_PAGE_SIZE, 0, POOL_PAGE_SIZE - length % POOL_PAGE_SIZE);
+	}
+	inode->length = length;
+	restore_flags(flags);
+
+	if(cur_process->file[fd].pos > length)
+		cur_process->file[fd].pos = length;
+	return 0;
+}
+
+/*
+ * tmpfs_inode_t* tmpfs_file_at(uint32_t index)
+ * Inputs: uint32_t index - position in the tmp/ listing
+ * Outputs: None
+ * Return Value: the file at that position, NULL past the end
+ * Side Effects: None
+ */
+static tmpfs_inode_t* tmpfs_file_at(uint32_t index)
+{
+	tmpfs_inode_t* inode;
+
+	for(inode = tmpfs_files; inode != NULL && index > 0; inode = inode->next)
+		index--;
+	return inode;
+}
+
+/*
+ * int32_t tmpfs_read_dir(int32_t fd, void* buf, int32_t nbytes)
+ * Inputs: int32_t fd - file descriptor of tmp/
+ * 		   void* buf - buffer for the name
+ * 		   int32_t nbytes - size of buf
+ * Outputs: None
+ * Return Value: length of the next name in tmp/, 0 once every name has been read
+ * Side Effects: Advances the directory position
+ */
+int32_t tmpfs_read_dir(int32_t fd, void* buf, int32_t nbytes)
+{
+	pcb_t* cur_process = get_pcb_address();
+	tmpfs_inode_t* inode = tmpfs_file_at(cur_process->file[fd].pos);
+	int32_t len;
+
+	if(inode == NULL)
+		return 0;
+	memset(buf, 0, nbytes < FILENAME_LEN + 1 ? nbytes : FILENAME_LEN + 1);
+	strncpy((int8_t*)buf, inode->file_name, nbytes < FILENAME_LEN ? nbytes : FILENAME_LEN);
+	cur_process->file[fd].pos++;
+	len = strlen(inode->file_name);
+	return len > FILENAME_LEN ? FILENAME_LEN : len;
+}
+
+/*
+ * int32_t tmpfs_read_dirents(int32_t fd, void* buf, int32_t nbytes)
+ * Inputs: int32_t fd - file descriptor of tmp/
+ * 		   void* buf - buffer to fill with dirent_t records
+ * 		   int32_t nbytes - size of buf in bytes
+ * Outputs: None
+ * Return Value: bytes of records written, 0 once every file has been returned
+ * Side Effects: Advances the directory position past the returned files
+ */
+int32_t tmpfs_read_dirents(int32_t fd, void* buf, int32_t nbytes)
+{
+	pcb_t* cur_process = get_pcb_address();
+	tmpfs_inode_t* inode = tmpfs_file_at(cur_process->file[fd].pos);
+	dirent_t* record = (dirent_t*)buf;
+	int32_t nbytes_read = 0;
+
+	while(nbytes - nbytes_read >= (int32_t)sizeof(dirent_t) && inode != NULL){
+		memset(record, 0, sizeof(dirent_t));
+		strncpy(record->file_name, inode->file_name, FILENAME_LEN);
+		record->file_type = 2;
+		record->length = inode->length;
+		cur_process->file[fd].pos++;
+		nbytes_read += sizeof(dirent_t);
+		record++;
+		inode = inode->next;
+	}
+	return nbytes_read;
+}
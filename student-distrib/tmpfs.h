@@ -0,0 +1,50 @@
+/* tmpfs.h - RAM-backed scratch filesystem mounted under tmp/ */
+
+#ifndef _TMPFS_H
+#define _TMPFS_H
+
+#include "types.h"
+#include "filesys.h"
+#include "pagepool.h"
+
+#define TMPFS_PREFIX		"tmp"
+#define TMPFS_PREFIX_LEN	3
+#define TMPFS_ROOT			0			// fd inode of the tmp/ directory itself
+#define TMPFS_FILE_PAGES	(POOL_PAGE_SIZE / sizeof(uint8_t*))	// data pages one file can have
+#define TMPFS_MAX_FILE_LEN	(TMPFS_FILE_PAGES * POOL_PAGE_SIZE)
+#ifndef ASM
+
+/* tmpfs file, allocated with kmalloc */
+typedef struct tmpfs_inode {
+	int8_t file_name[FILENAME_LEN];
+	uint32_t length;
+	uint32_t open_count;			/* fds open on the file */
+	uint32_t unlinked;				/* name is gone, the file is freed at its last close */
+	uint8_t** pages;				/* pool page holding the data page pointers, NULL while empty */
+	struct tmpfs_inode* next;		/* next file in tmp/ */
+} tmpfs_inode_t;
+
+const uint8_t* tmpfs_name(const uint8_t* filename);
+int32_t tmpfs_create(const uint8_t* filename);
+int32_t tmpfs_unlink(const uint8_t* filename);
+int32_t tmpfs_stat(const uint8_t* filename, stat_t* st);
+void tmpfs_fstat(int32_t fd, stat_t* st);
+
+int32_t tmpfs_open(const uint8_t* filename);
+void tmpfs_retain(int32_t file);
+void tmpfs_release(int32_t file);
+int32_t tmpfs_read_data(tmpfs_inode_t* inode, uint32_t offset, uint8_t* buf, uint32_t length);
+int32_t tmpfs_write_data(tmpfs_inode_t* inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+int32_t tmpfs_close(int32_t fd);
+int32_t tmpfs_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t tmpfs_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t tmpfs_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+int32_t tmpfs_lseek(int32_t fd, int32_t offset, int32_t whence);
+int32_t tmpfs_truncate(int32_t fd, int32_t length);
+
+int32_t tmpfs_read_dir(int32_t fd, void* buf, int32_t nbytes);
+int32_t tmpfs_read_dirents(int32_t fd, void* buf, int32_t nbytes);
+
+#endif /* ASM */
+
+#endif /* _TMPFS_H */
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "ece391support.h"
@@ -176,6 +177,27 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
+int32_t 
+ece391_mmap (int32_t fd, uint8_t** start)
+{
+    struct stat st;
+    void* file_image;
+
+    if (NULL != dir && dir_fd == fd)
+        return -1;
+    if (-1 == fstat (fd, &st) || 0 == st.st_size)
+        return -1;
+
+    if ((file_image = mmap ((void*)0, st.st_size, PROT_READ, MAP_PRIVATE,
+                    fd, 0)) == MAP_FAILED) {
+        perror ("mmap file");
+        return -1;
+    }
+
+    *start = (uint8_t*)file_image;
+    return st.st_size;
+}
+
 int32_t 
 ece391_read (int32_t fd, void* buf, int32_t nbytes)
 {
@@ -205,6 +227,141 @@ ece391_read (int32_t fd, void* buf, int32_t nbytes)
     return copied;
 }
 
+static void
+fill_stat (const struct stat* st, ece391_stat_t* buf)
+{
+    if (S_ISDIR (st->st_mode)) {
+        buf->type = 1;
+	buf->inode = 0;
+	buf->length = 0;
+    } else {
+        buf->type = 2;
+	buf->inode = st->st_ino;
+	buf->length = st->st_size;
+    }
+}
+
+int32_t 
+ece391_stat (const uint8_t* filename, ece391_stat_t* buf)
+{
+    struct stat st;
+
+    if (-1 == stat ((const char*)filename, &st))
+        return -1;
+    fill_stat (&st, buf);
+    return 0;
+}
+
+int32_t 
+ece391_fstat (int32_t fd, ece391_stat_t* buf)
+{
+    struct stat st;
+
+    if (NULL != dir && dir_fd == fd) {
+        buf->type = 1;
+	buf->inode = 0;
+	buf->length = 0;
+	return 0;
+    }
+    if (-1 == fstat (fd, &st))
+        return -1;
+    fill_stat (&st, buf);
+    return 0;
+}
+
+int32_t 
+ece391_lseek (int32_t fd, int32_t offset, int32_t whence)
+{
+    if (NULL != dir && dir_fd == fd)
+        return -1;
+    return lseek (fd, offset, whence);
+}
+
+int32_t 
+ece391_pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset)
+{
+    if (NULL != dir && dir_fd == fd)
+        return -1;
+    return pread (fd, buf, nbytes, offset);
+}
+
+int32_t 
+ece391_create (const uint8_t* filename)
+{
+    int fd;
+
+    if (-1 == (fd = open ((const char*)filename, O_WRONLY | O_CREAT | O_EXCL, 0644)))
+        return -1;
+    (void)close (fd);
+    return 0;
+}
+
+int32_t 
+ece391_ftruncate (int32_t fd, int32_t length)
+{
+    if (NULL != dir && dir_fd == fd)
+        return -1;
+    return ftruncate (fd, length);
+}
+
+int32_t 
+ece391_unlink (const uint8_t* filename)
+{
+    return unlink ((const char*)filename);
+}
+
+int32_t 
+ece391_fork (void)
+{
+    pid_t pid;
+
+    /* like the kernel, the parent waits for the child to halt */
+    if (0 < (pid = fork ()))
+        (void)waitpid (pid, NULL, 0);
+    return pid;
+}
+
+void* 
+ece391_brk (void* addr)
+{
+    if (NULL != addr && 0 != brk (addr))
+        return (void*)-1;
+    return sbrk (0);
+}
+
+int32_t 
+ece391_getdents (int32_t fd, void* buf, int32_t nbytes)
+{
+    struct dirent* de;
+    struct stat st;
+    ece391_stat_t info;
+    ece391_dirent_t* rec = buf;
+    int32_t filled, i;
+
+    if (NULL == dir || dir_fd != fd)
+        return -1;
+    filled = 0;
+    while (nbytes - filled >= (int32_t)sizeof (*rec)) {
+        if (NULL == (de = readdir (dir)))
+	    break;
+	for (i = 0; i < sizeof (*rec); i++)
+	    ((uint8_t*)rec)[i] = '\0';
+	for (i = 0; i < 32 && '\0' != de->d_name[i]; i++)
+	    rec->name[i] = de->d_name[i];
+	if (-1 != stat (de->d_name, &st)) {
+	    fill_stat (&st, &info);
+	    rec->type = info.type;
+	    rec->inode = info.inode;
+	    rec->length = info.length;
+	} else {
+	    rec->type = 1;
+	}
+	filled += sizeof (*rec);
+	rec++;
+    }
+    return filled;
+}
+
 int32_t 
 ece391_write (int32_t fd, const void* buf, int32_t nbytes)
 {
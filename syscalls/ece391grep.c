@@ -4,19 +4,45 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
-#define SBUFSIZE 33
+#define NUM_DIRENTS 63
 
 int32_t
 do_one_file (const char* s, const char* fname) 
 {
     int32_t fd, cnt, last, line_start, line_end, check, s_len;
     uint8_t data[BUFSIZE+1];
+    uint8_t* map;
 
     s_len = ece391_strlen ((uint8_t*)s);
     if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
         ece391_fdputs (1, (uint8_t*)"file open failed\n");
         return -1;
     }
+    /* search regular files in place through their mapping */
+    if (-1 != (cnt = ece391_mmap (fd, &map))) {
+	line_start = 0;
+	while (line_start < cnt) {
+	    line_end = line_start;
+	    while (line_end < cnt && '\n' != map[line_end])
+		line_end++;
+	    for (check = line_start; check + s_len <= line_end; check++) {
+		if (s[0] == map[check] && 
+		    0 == ece391_strncmp (map + check, (uint8_t*)s, s_len)) {
+		    ece391_fdputs (1, (uint8_t*)fname);
+		    ece391_fdputs (1, (uint8_t*)":");
+		    (void)ece391_write (1, map + line_start, line_end - line_start);
+		    ece391_fdputs (1, (uint8_t*)"\n");
+		    break;
+		}
+	    }
+	    line_start = line_end + 1;
+	}
+	if (-1 == ece391_close (fd)) {
+	    ece391_fdputs (1, (uint8_t*)"file close failed\n");
+	    return -1;
+	}
+	return 0;
+    }
     last = 0;
     while (1) {
         cnt = ece391_read (fd, data + last, BUFSIZE - last);
@@ -67,8 +93,8 @@ do_one_file (const char* s, const char* fname)
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, i;
+    ece391_dirent_t ents[NUM_DIRENTS];
     uint8_t search[BUFSIZE];
 
     if (0 != ece391_getargs (search, BUFSIZE)) {
@@ -81,16 +107,17 @@ int main ()
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	    return 3;
 	}
-	if ('.' == buf[0]) /* a directory... */
-	    continue;
-	buf[cnt] = '\0';
-	if (0 != do_one_file ((char*)search, (char*)buf))
-	    return 3;
+	for (i = 0; i < cnt / sizeof (ece391_dirent_t); i++) {
+	    if (2 != ents[i].type) /* a directory or the RTC... */
+		continue;
+	    if (0 != do_one_file ((char*)search, (char*)ents[i].name))
+		return 3;
+	}
     }
 
     return 0;
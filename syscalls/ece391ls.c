@@ -3,26 +3,34 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
-#define SBUFSIZE 33
+#define NUM_DIRENTS 63
+#define BUFSIZE 1024
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, i;
+    ece391_dirent_t ents[NUM_DIRENTS];
+    uint8_t dir[BUFSIZE];
 
-    if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
+    /* list the directory named on the command line, the root by default */
+    if (0 != ece391_getargs (dir, BUFSIZE) || '\0' == dir[0])
+        ece391_strcpy (dir, (uint8_t*)".");
+
+    if (-1 == (fd = ece391_open (dir))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    /* the whole directory normally comes back from the first call */
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
-	        return 3;
+	    for (i = 0; i < cnt / sizeof (ece391_dirent_t); i++) {
+	        ece391_fdputs (1, ents[i].name);
+	        ece391_fdputs (1, (uint8_t*)"\n");
+	    }
     }
 
     return 0;
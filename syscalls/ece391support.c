@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdint.h>
 
 #include "ece391support.h"
@@ -102,3 +103,131 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+/*
+ * Heap for ece391_malloc.  Blocks of each power of two size class are kept
+ * on a free list of their own, so malloc and free of small blocks only move
+ * list heads and never trap into the kernel.  A class whose list is empty is
+ * refilled with a batch of blocks carved from the arena, which grows with
+ * ece391_brk by at least MALLOC_CHUNK bytes when it runs out.  Blocks bigger
+ * than the largest class are carved one at a time and reused first fit.
+ */
+#define MALLOC_MIN_SHIFT 4              /* smallest class, 16 bytes */
+#define MALLOC_CLASSES   8              /* 16, 32, ... 2048 bytes */
+#define MALLOC_MAX_SIZE  (1 << (MALLOC_MIN_SHIFT + MALLOC_CLASSES - 1))
+#define MALLOC_REFILL    4096           /* bytes of blocks carved for a class at once */
+#define MALLOC_CHUNK     0x10000        /* least the heap grows by */
+/* largest request: rounding it and adding the header must not wrap, and sbrk takes an int32_t */
+#define MALLOC_LIMIT     (0x7FFFFFFF - sizeof(malloc_block_t) - 15)
+
+/* Header in front of every block, 16 bytes so the data stays 16 byte aligned */
+typedef struct malloc_block {
+    uint32_t size;                      /* bytes after the header */
+    uint32_t size_class;                /* MALLOC_CLASSES for a large block */
+    struct malloc_block* next;          /* next free block, only while free */
+    uint32_t pad;
+} malloc_block_t;
+
+/* free blocks of each class, the last list holds the large ones */
+static malloc_block_t* malloc_free[MALLOC_CLASSES + 1];
+static uint8_t* arena_next = NULL;
+static uint8_t* arena_end = NULL;
+
+/* Move the end of the heap by increment bytes; returns the old end, (void*)-1 on failure */
+void* ece391_sbrk(int32_t increment)
+{
+    uint8_t* old = ece391_brk(NULL);
+
+    if ((void*)-1 == old || (0 != increment && (void*)-1 == ece391_brk(old + increment)))
+        return (void*)-1;
+    return old;
+}
+
+/* Take bytes (a multiple of 16) from the arena, growing the heap if needed */
+static void* arena_carve(uint32_t bytes)
+{
+    uint32_t grow;
+    uint8_t* start;
+    void* carved;
+
+    if ((uint32_t)(arena_end - arena_next) < bytes) {
+        grow = bytes > MALLOC_CHUNK ? bytes : MALLOC_CHUNK;
+        if ((void*)-1 == (start = ece391_sbrk(grow)))
+            return NULL;
+        /* someone else moved the break, the old arena's tail is lost */
+        if (start != arena_end)
+            arena_next = start;
+        arena_end = start + grow;
+    }
+    carved = arena_next;
+    arena_next += bytes;
+    return carved;
+}
+
+/* Put a batch of new blocks on the free list of a class; returns -1 if the heap is full */
+static int32_t malloc_refill(uint32_t size_class)
+{
+    uint32_t size = 1 << (MALLOC_MIN_SHIFT + size_class);
+    uint32_t block_size = sizeof(malloc_block_t) + size;
+    uint32_t count = MALLOC_REFILL / block_size;
+    malloc_block_t* block;
+    uint8_t* batch;
+
+    if (0 == count)
+        count = 1;
+    if (NULL == (batch = arena_carve(count * block_size)))
+        return -1;
+    while (count-- > 0) {
+        block = (malloc_block_t*)(batch + count * block_size);
+        block->size = size;
+        block->size_class = size_class;
+        block->next = malloc_free[size_class];
+        malloc_free[size_class] = block;
+    }
+    return 0;
+}
+
+/* Allocate size bytes, 16 byte aligned; returns NULL if size is 0 or too big, or the heap is full */
+void* ece391_malloc(uint32_t size)
+{
+    malloc_block_t** link;
+    malloc_block_t* block;
+    uint32_t size_class;
+
+    if (0 == size || size > MALLOC_LIMIT)
+        return NULL;
+
+    if (size > MALLOC_MAX_SIZE) {
+        size = (size + 15) & ~15;
+        for (link = &malloc_free[MALLOC_CLASSES]; NULL != *link; link = &(*link)->next) {
+            if ((*link)->size >= size) {
+                block = *link;
+                *link = block->next;
+                return block + 1;
+            }
+        }
+        if (NULL == (block = arena_carve(sizeof(malloc_block_t) + size)))
+            return NULL;
+        block->size = size;
+        block->size_class = MALLOC_CLASSES;
+        return block + 1;
+    }
+
+    for (size_class = 0; (1U << (MALLOC_MIN_SHIFT + size_class)) < size; size_class++);
+    if (NULL == malloc_free[size_class] && -1 == malloc_refill(size_class))
+        return NULL;
+    block = malloc_free[size_class];
+    malloc_free[size_class] = block->next;
+    return block + 1;
+}
+
+/* Give back a block from ece391_malloc, or NULL */
+void ece391_free(void* ptr)
+{
+    malloc_block_t* block;
+
+    if (NULL == ptr)
+        return;
+    block = (malloc_block_t*)ptr - 1;
+    block->next = malloc_free[block->size_class];
+    malloc_free[block->size_class] = block;
+}
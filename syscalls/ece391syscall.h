@@ -3,6 +3,27 @@
 
 #include <stdint.h>
 
+/* File information filled in by ece391_stat and ece391_fstat. */
+typedef struct ece391_stat {
+    int32_t type;               /* 0 = RTC, 1 = directory, 2 = regular file */
+    uint32_t inode;             /* 0 for the RTC and directories */
+    uint32_t length;            /* file length in bytes */
+} ece391_stat_t;
+
+/* whence values for ece391_lseek */
+#define ECE391_SEEK_SET 0
+#define ECE391_SEEK_CUR 1
+#define ECE391_SEEK_END 2
+
+/* One directory record filled in by ece391_getdents. */
+typedef struct ece391_dirent {
+    uint32_t inode;             /* 0 for the RTC and directories */
+    uint32_t length;            /* file length in bytes */
+    int32_t type;               /* 0 = RTC, 1 = directory, 2 = regular file */
+    uint8_t name[33];           /* null terminated */
+    uint8_t reserved[3];
+} ece391_dirent_t;
+
 /* All calls return >= 0 on success or -1 on failure. */
 
 /*  
@@ -21,6 +42,23 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+/* Maps an open file read-only; returns its length and sets *start. */
+extern int32_t ece391_mmap (int32_t fd, uint8_t** start);
+/* Fills buf with directory records; returns bytes filled, 0 at the end. */
+extern int32_t ece391_getdents (int32_t fd, void* buf, int32_t nbytes);
+extern int32_t ece391_stat (const uint8_t* filename, ece391_stat_t* buf);
+extern int32_t ece391_fstat (int32_t fd, ece391_stat_t* buf);
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset);
+/* Writable filesystem only: write() at the end of a file appends to it. */
+extern int32_t ece391_create (const uint8_t* filename);
+extern int32_t ece391_ftruncate (int32_t fd, int32_t length);
+/* tmp/<name> files live in kernel memory; unlink only removes those. */
+extern int32_t ece391_unlink (const uint8_t* filename);
+/* Copy-on-write clone of the caller; the parent resumes once the child halts. */
+extern int32_t ece391_fork (void);
+/* Moves the end of the heap to addr (NULL only asks); returns the new end, (void*)-1 on failure. */
+extern void* ece391_brk (void* addr);
 
 enum signums {
 	DIV_ZERO = 0,
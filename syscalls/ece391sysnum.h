@@ -11,5 +11,16 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_MMAP    11
+#define SYS_GETDENTS 12
+#define SYS_STAT    13
+#define SYS_FSTAT   14
+#define SYS_LSEEK   15
+#define SYS_PREAD   16
+#define SYS_CREATE  17
+#define SYS_FTRUNCATE 18
+#define SYS_UNLINK  19
+#define SYS_FORK    20
+#define SYS_BRK     21
 
 #endif /* ECE391SYSNUM_H */